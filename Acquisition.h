@@ -0,0 +1,88 @@
+#ifndef ACQUISITION_H_
+#define ACQUISITION_H_
+
+#include <inttypes.h>
+
+#include "Clock.h"
+#include "Sensors.h"
+
+/**
+ * DS18x20 conversion started at the end of sensor reads of one cycle and
+ * read at the start of the next one, so control, outputs and idle time
+ * of the cycle overlap the conversion instead of waiting for it.
+ * Latency of a role is the age of its sample when it is read, from the
+ * start of conversion, or from the read of a thermocouple chip.
+ *
+ * Example
+ *
+ * 		uint16_t due = acquisition.finish(delay_ms);
+ * 		... read due sensors, acquisition.sampled(role, age)
+ * 		... search, convert
+ * 		acquisition.start(due, Clock::millis());
+ */
+template <class DS>
+class Acquisition {
+public:
+	typedef typename DS::Sleep Sleep;
+
+	Acquisition() : pending(0), started(0) {
+		for (uint8_t i = 0; i < Sensors::RoleCount; ++i)
+			last[i] = worst[i] = 0;
+	}
+	// due is the mask of converting sensors
+	void start(uint16_t due, Clock::clock_t now) {
+		pending = due;
+		started = now;
+	}
+	bool isPending() const { return pending != 0; }
+	// ms since start()
+	uint16_t age(Clock::clock_t now) const {
+		uint32_t a = now - started;
+		return a > 0xFFFF ? 0xFFFF : a;
+	}
+	// ends strong pull-up of parasite powered sensors once conversion
+	// time has passed, so the bus is not held high until finish()
+	void release(Clock::clock_t now) {
+		if (pending && DS::isParasite() && age(now) >= DS::conversionTime())
+			DS::release();
+	}
+	// waits for the rest of conversion if any, returns the due mask once
+	uint16_t finish(Sleep sleep) {
+		if (!pending)
+			return 0;
+		uint16_t elapsed = age(Clock::millis());
+		uint16_t t = DS::conversionTime();
+		if (DS::isParasite()) {
+			if (elapsed < t)
+				sleep(t - elapsed);
+			DS::release();
+		} else if (elapsed < t) {
+			DS::wait(sleep);
+		}
+		uint16_t due = pending;
+		pending = 0;
+		return due;
+	}
+	// latency of a sample of role put to Snapshot
+	void sampled(Sensors::Role r, uint16_t age) {
+		last[r] = age;
+		if (age > worst[r])
+			worst[r] = age;
+	}
+	// ms, last/worst of roles read so far
+	template <class S>
+	S& log(S& s) const {
+		s << "latency";
+		for (uint8_t i = 0; i < Sensors::RoleCount; ++i)
+			if (worst[i])
+				s << ' ' << int(i) << '=' << last[i] << '/' << worst[i];
+		return s;
+	}
+private:
+	uint16_t pending;
+	Clock::clock_t started;
+	uint16_t last[Sensors::RoleCount];
+	uint16_t worst[Sensors::RoleCount];
+};
+
+#endif /* ACQUISITION_H_ */
@@ -0,0 +1,152 @@
+#ifndef AUTOTUNE_H_
+#define AUTOTUNE_H_
+
+#include <inttypes.h>
+
+#include "Clock.h"
+
+/**
+ * Relay feedback autotune (Astrom-Hagglund).
+ * Output is +amplitude while error is above hysteresis and -amplitude
+ * below it, the loop oscillates with its ultimate period Pu. Ultimate gain
+ * is Ku = 4 * amplitude / (pi * a), where a is half of error swing.
+ * Gains are calculated for Regul: output = p * err + integral + d term,
+ * integral grows by i * err / 16 per 5 s and d term is d * slope per 5 s.
+ *
+ * Example
+ *
+ * 		tuner.start(now);
+ * 		...
+ * 		output = tuner.step(current - target, now);
+ * 		if (tuner.status() == Autotune::Done)
+ * 			gains = tuner.result(Autotune::TyreusLuyben);
+ */
+class Autotune {
+public:
+	enum Rule : uint8_t {
+		ZieglerNichols,
+		TyreusLuyben
+	};
+	enum Status : uint8_t {
+		Off,
+		Running,
+		Done,
+		Failed
+	};
+	struct Result {
+		uint8_t p;
+		uint8_t i;
+		uint8_t d;
+	};
+	static const int16_t DefaultAmplitude = 1000; // ms of valve drive per step
+	static const int16_t Hysteresis = 2;          // 1/8 degree
+	static const uint8_t Cycles = 4;              // measured after the first one
+	static const Clock::clock_t MaxTime = 4UL * 3600 * 1000;
+
+	// zone to tune, set by console and taken at cycle boundary, see Console
+	enum Request : uint8_t {
+		NoRequest,
+		StopTuning,
+		TuneZone // + zone index, see Plant
+	};
+	static volatile uint8_t request;
+
+	Autotune() : state(Off) {}
+
+	void start(Clock::clock_t now, int16_t amplitude = DefaultAmplitude) {
+		state = Running;
+		h = amplitude;
+		relay = 0;
+		begin = now;
+		cycles = 0;
+		rises = 0;
+		periodSum = 0;
+		swingSum = 0;
+	}
+	void stop() {
+		state = Off;
+	}
+	Status status() const {
+		return Status(state);
+	}
+	bool isRunning() const {
+		return state == Running;
+	}
+	// returns relay output for err = current - target
+	int16_t step(int16_t err, Clock::clock_t now) {
+		if (state != Running)
+			return 0;
+		if (now - begin > MaxTime) {
+			state = Failed;
+			return 0;
+		}
+		if (relay == 0) {
+			relay = err > 0 ? h : -h;
+			high = low = err;
+		}
+		if (err > high)
+			high = err;
+		if (err < low)
+			low = err;
+		if (relay > 0 && err < -Hysteresis) {
+			relay = -h;
+		} else if (relay < 0 && err > Hysteresis) {
+			relay = h;
+			if (rises > 0) {
+				// first cycle is transient, skipped
+				periodSum += now - lastRise;
+				swingSum += high - low;
+				if (++cycles == Cycles)
+					state = Done;
+			}
+			++rises;
+			lastRise = now;
+			high = low = err;
+		}
+		return relay;
+	}
+	Result result(Rule rule) const {
+		uint32_t a = swingSum / (2 * cycles);
+		if (a == 0)
+			a = 1;
+		uint32_t pu = periodSum / cycles; // ms
+		uint32_t kp1000, ti, td;
+		if (rule == ZieglerNichols) {
+			kp1000 = uint32_t(h) * 764 / a; // 0.6 Ku
+			ti = pu / 2;
+			td = pu / 8;
+		} else {
+			kp1000 = uint32_t(h) * 579 / a; // Ku / 2.2
+			ti = pu * 22 / 10;
+			td = pu * 10 / 63;
+		}
+		if (ti == 0)
+			ti = 1;
+		Result r;
+		r.p = limit((kp1000 + 500) / 1000);
+		r.i = limit(kp1000 * 80 / ti);
+		r.d = limit((kp1000 / 100) * (td / 100) / 500);
+		return r;
+	}
+	// ultimate period and half swing, for log
+	uint32_t period() const { return cycles ? periodSum / cycles : 0; }
+	uint16_t amplitude() const { return cycles ? swingSum / (2 * cycles) : 0; }
+private:
+	static uint8_t limit(uint32_t v) {
+		return v > 255 ? 255 : v;
+	}
+
+	uint8_t state;
+	int16_t h;
+	int16_t relay;
+	int16_t high;
+	int16_t low;
+	Clock::clock_t begin;
+	Clock::clock_t lastRise;
+	uint8_t cycles;
+	uint8_t rises;
+	uint32_t periodSum;
+	uint32_t swingSum;
+};
+
+#endif /* AUTOTUNE_H_ */
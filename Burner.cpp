@@ -0,0 +1,75 @@
+#include <avr/pgmspace.h>
+
+#include "Burner.h"
+
+// first matching row wins, so NoDemand goes before the others
+static const Burner::Transition table[] PROGMEM = {
+	{Burner::Off,      Burner::Demand,   Burner::Starting},
+	{Burner::Starting, Burner::NoDemand, Burner::Off},
+	{Burner::Starting, Burner::Timeout,  Burner::Igniting},
+	{Burner::Igniting, Burner::NoDemand, Burner::Stopping},
+	{Burner::Igniting, Burner::Lit,      Burner::Burning},
+	{Burner::Igniting, Burner::NotLit,   Burner::Restart},
+	{Burner::Igniting, Burner::Retry,    Burner::Restart},
+	{Burner::Burning,  Burner::NoDemand, Burner::Stopping},
+	{Burner::Burning,  Burner::Cooling,  Burner::Cold},
+	{Burner::Cold,     Burner::NoDemand, Burner::Stopping},
+	{Burner::Cold,     Burner::Lit,      Burner::Burning},
+	{Burner::Cold,     Burner::Retry,    Burner::Restart},
+	{Burner::Stopping, Burner::Demand,   Burner::Burning},
+	{Burner::Stopping, Burner::Timeout,  Burner::Off},
+	{Burner::Restart,  Burner::NoDemand, Burner::Off},
+	{Burner::Restart,  Burner::Timeout,  Burner::Igniting},
+};
+
+static const char names[Burner::StateCount][10] PROGMEM = {
+	"off", "starting", "igniting", "burning", "cold", "stopping", "restart"
+};
+
+bool Burner::step(bool wanted, Temperature flame, Clock::clock_t now) {
+	demand = wanted;
+	tc = flame;
+	trend.put(flame, now);
+	for (uint8_t i = 0; i < sizeof(table) / sizeof(table[0]); ++i) {
+		Transition t;
+		memcpy_P(&t, &table[i], sizeof(t));
+		if (t.from == state && holds(t.event, now)) {
+			state = t.to;
+			entered = now;
+			if (state == Restart && attempts < MaxAttempts)
+				++attempts;
+			// a new demand starts with all quick restarts again
+			if (state == Burning || state == Off || state == Starting)
+				attempts = 0;
+			return true;
+		}
+	}
+	return false;
+}
+
+uint32_t Burner::timeout() const {
+	const Settings& s = Params::active;
+	return state == Starting ? uint32_t(s.boilerDelay) * 1000
+			: state == Stopping ? uint32_t(s.boilerDelayOff) * 1000
+			: uint32_t(RestartTime) * 1000;
+}
+
+bool Burner::holds(Event e, Clock::clock_t now) const {
+	uint32_t elapsed = now - entered;
+	switch (e) {
+	case Demand:   return demand;
+	case NoDemand: return !demand;
+	case Timeout:  return elapsed >= timeout();
+	case Lit:      return isLit();
+	case NotLit:
+		return attempts < MaxAttempts && elapsed >= uint32_t(IgnitionTime) * 1000
+				&& trend.isKnown() && !isLit();
+	case Cooling:  return !tc.isValid() || isFalling() || (tc.get() < TCHigh && !isHeating());
+	case Retry:    return elapsed >= uint32_t(Params::active.boilerRetryDelay) * 1000 && !isLit();
+	}
+	return false;
+}
+
+void Burner::name(State s, char* buf) {
+	memcpy_P(buf, names[s], sizeof(names[s]));
+}
@@ -0,0 +1,150 @@
+#ifndef BURNER_H_
+#define BURNER_H_
+
+#include <inttypes.h>
+
+#include "Clock.h"
+#include "Params.h"
+#include "Cascade.h"
+#include "temperature.h"
+
+/**
+ * Slope of the thermocouple over the last Size samples, taken at least
+ * Spacing apart, in 1/16 degree per minute. Unknown until the window is full.
+ */
+class Trend {
+public:
+	static const uint8_t Size = 4;
+	static const uint16_t Spacing = 10000; // ms, 0.25 degree steps of max6675
+
+	Trend() : head(0), count(0) {}
+	void put(Temperature t, Clock::clock_t now) {
+		if (!t.isValid()) {
+			count = 0;
+			return;
+		}
+		if (count > 0 && now - time[head] < Spacing)
+			return;
+		head = count > 0 ? (head + 1) % Size : 0;
+		value[head] = t.get();
+		time[head] = now;
+		if (count < Size)
+			++count;
+	}
+	bool isKnown() const { return count == Size; }
+	int16_t slope() const {
+		if (!isKnown())
+			return 0;
+		uint8_t oldest = (head + 1) % Size;
+		int32_t dt = (time[head] - time[oldest]) / 1000; // s, Spacing * (Size - 1) at least
+		return Fixed::saturate(int32_t(value[head] - value[oldest]) * 60 / dt);
+	}
+private:
+	int16_t value[Size];
+	Clock::clock_t time[Size];
+	uint8_t head;
+	uint8_t count;
+};
+
+/**
+ * Burner relay as a state machine. Each step takes the first row of
+ * the transition table whose state matches and whose event holds.
+ * Ignition is judged by the thermocouple trend: a lit burner heats it
+ * by RiseRate at least, so a failed start is restarted after
+ * IgnitionTime instead of the whole boilerRetryDelay. A lost flame is
+ * seen by FallRate, long before the thermocouple is below TCHigh.
+ * After MaxAttempts quick restarts in a row it waits boilerRetryDelay.
+ *
+ *   Off      -Demand->   Starting  -boilerDelay->    Igniting
+ *   Igniting -Lit->      Burning   -Cooling->        Cold
+ *   Cold     -Lit->      Burning
+ *   Igniting -NotLit->   Restart   -RestartTime->    Igniting
+ *   Cold     -Retry->    Restart
+ *   any on   -NoDemand-> Stopping  -boilerDelayOff-> Off
+ *
+ * Example
+ *
+ * 		burner.step(demand, frame.get(Sensors::Thermocouple, now), now);
+ * 		BOILER_ON::Set(burner.isOn());
+ */
+class Burner {
+public:
+	enum State : uint8_t {
+		Off,
+		Starting, // relay off, waiting boilerDelay
+		Igniting, // relay on, trend not yet rising
+		Burning,
+		Cold,     // relay on, flame lost or boiler thermostat off
+		Stopping, // relay on, waiting boilerDelayOff
+		Restart,  // relay off for RestartTime to trigger ignition
+		StateCount
+	};
+	enum Event : uint8_t {
+		Demand,
+		NoDemand,
+		Timeout,  // of state, see timeout()
+		Lit,      // heating up, or hot and not cooling
+		NotLit,   // trend stays flat for IgnitionTime, up to MaxAttempts
+		Cooling,  // falling, or below TCHigh and not heating up
+		Retry     // cold for boilerRetryDelay
+	};
+	struct Transition {
+		State from;
+		Event event;
+		State to;
+	};
+	struct Saved {
+		State state;
+		uint32_t elapsed; // ms in state
+	};
+	static const int16_t TCHigh = BoilerDefaults::TCHigh;
+	static const int16_t RiseRate = (2_K).get(); // per minute
+	static const int16_t FallRate = (2_K).get();
+	static const uint16_t IgnitionTime = 60;     // s
+	static const uint16_t RestartTime = 30;      // s
+	static const uint8_t MaxAttempts = 3;
+
+	Burner() : state(Off), entered(0), demand(false), attempts(0), tc() {}
+
+	// returns true if state changed
+	bool step(bool wanted, Temperature flame, Clock::clock_t now);
+	State getState() const { return state; }
+	// relay output
+	bool isOn() const {
+		return state == Igniting || state == Burning || state == Cold || state == Stopping;
+	}
+	bool isWanted() const { return demand; }
+	int16_t slope() const { return trend.slope(); }
+
+	void save(Saved& s, Clock::clock_t now) const {
+		s.state = state;
+		s.elapsed = now - entered;
+	}
+	void restore(const Saved& s, Clock::clock_t now) {
+		state = s.state < StateCount ? s.state : Off;
+		entered = now - s.elapsed;
+		demand = isOn();
+		attempts = 0;
+	}
+	// name of state for log, up to 9 characters
+	static void name(State s, char* buf);
+private:
+	// trend is 0 while unknown
+	bool isHeating() const { return trend.slope() >= RiseRate; }
+	bool isFalling() const { return trend.slope() <= -FallRate; }
+	bool isLit() const {
+		return tc.isValid() && (isHeating() || (tc.get() >= TCHigh && !isFalling()));
+	}
+	// ms to Timeout of states waiting for it
+	uint32_t timeout() const;
+	bool holds(Event e, Clock::clock_t now) const;
+
+	State state;
+	Clock::clock_t entered;
+	bool demand;
+	uint8_t attempts; // restarts since burning or since the demand began
+	Temperature tc;
+	Trend trend;
+};
+
+#endif /* BURNER_H_ */
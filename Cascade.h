@@ -11,6 +11,13 @@
 
 #include "Regulator.h"
 #include "OneWire.h"
+#include "Params.h"
+#include "Snapshot.h"
+#include "Clock.h"
+#include "Autotune.h"
+#include "Valve.h"
+#include "HeatingCurve.h"
+#include "OutdoorTrend.h"
 
 template <typename D, int Up, int Down = 0>
 class Action {
@@ -46,26 +53,62 @@ struct Data {
 	static uint8_t data;
 };
 
-template <class R, class Action>
+// block of values of one cascade, see Cascade::registers()
+namespace CascadeRegister {
+enum : uint8_t {
+	Target,
+	Current,
+	Output,
+	Valve,   // percent
+	P,
+	I,
+	D,
+	Flags,   // Tuning | Homing | Failed
+	Count
+};
+enum : uint8_t {
+	Tuning = 1,
+	Homing = 2,
+	Failed = 4
+};
+}
+
+// Period is ms between control steps
+template <class R, class Action, uint16_t Period = 5000, class Valve = ValvePosition<> >
 class Cascade {
 public:
+	static const uint16_t period = Period;
+	static_assert(Period <= 32767, "valve run of a step is 16 bit");
 	typedef Action action_t;
 	typedef typename R::input_t input_t;
-	Cascade(input_t target, uint8_t p) : failCount(0), current(0), regul(target, p) {}
-	void processSensor(const OneWire::Addr& addr, input_t value) { }
+	struct State {
+		typename R::State regul;
+		input_t current;
+		int32_t valve;
+	};
+	Cascade(input_t target, uint8_t p, uint8_t i, uint8_t d) : failCount(0), current(0), regul(target, p, i, d),
+			drive(0), lastStep(0), runEnd(0), started(false), running(false) {}
+	bool isDue(Clock::clock_t now) const {
+		return !started || now - lastStep >= Period;
+	}
 	// returns false on fail
-	bool step() {
+	bool step(Clock::clock_t now) {
+		Clock::clock_t dt = started ? now - lastStep : Period;
+		lastStep = now;
+		started = true;
 		if (failCount > 5) {
-			action_t::down();
+			output_t v = regul.getOutput();
+			move(v < 0 ? -v : v, now);
 			return false;
 		}
-		output_t output = regul.step(current);
-
-		if (output < 0) {
-			Action::up();
+		output_t output;
+		if (tuner.isRunning()) {
+			output = tuner.step(current - regul.getTarget(), now);
+			regul.force(output);
 		} else {
-			Action::down();
+			output = regul.step(current, dt > 0xFFFF ? 0xFFFF : dt);
 		}
+		move(output, now);
 
 		failCount++;
 		return true;
@@ -73,23 +116,108 @@ public:
 	template <class S>
 	S& log(S& s) const {
 		s << "Current: " << current << ", ";
+		if (tuner.isRunning())
+			s << "Tune, ";
+		if (valve.isHoming())
+			s << "Homing, ";
 		regul.log(s);
+		s << ", valve: " << int(valve.percent()) << '%';
 		return s;
 	}
+	// relay autotune replaces regulator until done
+	void startTune(Clock::clock_t now) {
+		tuner.start(now);
+	}
+	void stopTune() {
+		tuner.stop();
+	}
+	Autotune::Status tuneStatus() const {
+		return tuner.status();
+	}
+	Autotune::Result tuneResult(Autotune::Rule rule) const {
+		return tuner.result(rule);
+	}
+	void save(State& s) const {
+		s.regul = regul.save();
+		s.current = current;
+		s.valve = valve.get();
+	}
+	void restore(const State& s) {
+		regul.restore(s.regul);
+		current = s.current;
+		valve.restore(s.valve);
+	}
 	output_t getTarget() const {
 		return regul.getTarget();
 	}
 	output_t getOutput() const {
 		return regul.getOutput();
 	}
+	void registers(int16_t* r) const {
+		namespace Reg = CascadeRegister;
+		r[Reg::Target] = regul.getTarget();
+		r[Reg::Current] = current;
+		r[Reg::Output] = regul.getOutput();
+		r[Reg::Valve] = valve.percent();
+		r[Reg::P] = regul.getP();
+		r[Reg::I] = regul.getI();
+		r[Reg::D] = regul.getD();
+		r[Reg::Flags] = (tuner.isRunning() ? Reg::Tuning : 0) | (valve.isHoming() ? Reg::Homing : 0)
+				| (failCount > 5 ? Reg::Failed : 0);
+	}
+	// ms of valve drive after the last step, 0 if the valve can not move
 	output_t getAbsOutput() const {
-		output_t v = regul.getOutput();
-		return v < 0 ? -v : v;
+		return drive < 0 ? -drive : drive;
+	}
+	// valve set by the last step is driven from now on, see stopRun()
+	void startRun(Clock::clock_t now) {
+		runEnd = now + getAbsOutput();
+		running = drive != 0;
+	}
+	// stops the valve once its drive time is over, true if it did
+	bool stopRun(Clock::clock_t now) {
+		if (!running || int32_t(now - runEnd) < 0)
+			return false;
+		Action::stop();
+		running = false;
+		return true;
+	}
+	bool isRunning() const {
+		return running;
+	}
+	Clock::clock_t getRunEnd() const {
+		return runEnd;
 	}
 protected:
 	uint8_t failCount;
 	input_t current;
 	R regul;
+	Autotune tuner;
+private:
+	// set direction of run, positive is down; output is ms of run per
+	// ReferencePeriod of gains, a step of Period runs in proportion,
+	// the whole Period at most
+	void move(output_t output, Clock::clock_t now) {
+		int32_t run = int32_t(output) * Period / R::ReferencePeriod;
+		if (run > int32_t(Period))
+			run = Period;
+		else if (run < -int32_t(Period))
+			run = -int32_t(Period);
+		drive = valve.command(run, Period, now);
+		if (drive < 0)
+			Action::up();
+		else if (drive > 0)
+			Action::down();
+		else
+			Action::stop();
+	}
+
+	Valve valve;
+	output_t drive;
+	Clock::clock_t lastStep;
+	Clock::clock_t runEnd;
+	bool started;
+	bool running;
 };
 
 template <class S, class T, typename T::input_t dummy = 0>
@@ -98,149 +226,217 @@ S& operator<<(S& s, const T& x)
 	return x.log(s);
 }
 
-typedef Cascade<Regul<int16_t, 4000, -4000>, Action<Data, 6, 7>> RadiatorCascadeParent;
-class RadiatorCascade: public RadiatorCascadeParent {
+// gains of a zone in Settings
+template <uint8_t Settings::*P, uint8_t Settings::*I, uint8_t Settings::*D>
+struct Gains {
+	static uint8_t p(const Settings& s) { return s.*P; }
+	static uint8_t i(const Settings& s) { return s.*I; }
+	static uint8_t d(const Settings& s) { return s.*D; }
+};
+
+struct RadiatorDefaults {
+	static const int16_t Min = (22_C).get();
+	static const int16_t Max = (70_C).get();
+	// defaults of Settings::radiatorShift, radiatorRoomK, indoorTarget and radiatorLead
+	static const int16_t Shift = (0_K).get();
+	static const int16_t RoomK = 4;
+	static const int16_t IndoorTarget = (22_C).get();
+	static const uint8_t Lead = 60; // minutes
+	static const int16_t OutdoorAvg = (-5_C).get(); // winter avg
+};
+
+/**
+ * Radiator zone, mixing valve keeps feed temperature of HeatingCurve.
+ * Target temperature is HeatingCurve(outdoor + trend * Lead) + Shift
+ * + (IndoorTarget - indoor) * RoomK, limited by Min and Max, where trend
+ * is of OutdoorTrend. A stale outdoor sensor keeps the last average of
+ * the history. Zone is a configuration, see Zones.h.
+ */
+template <class Zone>
+class RadiatorCascade: public Cascade<Regul<int16_t, 4000, -4000>, typename Zone::Valve, Zone::Period>,
+		public RadiatorDefaults {
 public:
-	typedef RadiatorCascadeParent parent_t;
-	using parent_t::input_t;
-	static const input_t Min = Temperature::toInt(22);
-	static const input_t Max = Temperature::toInt(70);
-	static const input_t Zero = Temperature::toInt(40);
-	static const input_t k = 2;
-	static const input_t IndoorTarget = Temperature::toInt(22);
-	static const input_t OutdoorAvg = Temperature::toInt(-5); // winter avg
-	// target temperature is (Zero - outdoor) / k + (IndoorTarget - indoor) * 4,
-	// limited by Min and Max
-
-	static const input_t Fail = Temperature::toInt(85);
-
-	RadiatorCascade() :  parent_t(Zero, 2), indoor(IndoorTarget), outdoor(OutdoorAvg) {}
-	void processSensor(const OneWire::Addr& addr, input_t value) {
-		if (radiatorSensor == addr) {
-			if (value == Fail && current < Temperature::toInt(60)) {
-				// problem with power level on ds1820, skip value
-				return;
-			}
+	typedef Cascade<Regul<int16_t, 4000, -4000>, typename Zone::Valve, Zone::Period> parent_t;
+	typedef typename parent_t::input_t input_t;
+	typedef typename parent_t::State State;
+	typedef Zone zone_t;
+
+	RadiatorCascade() :  parent_t(HeatingCurve::feed(Temperature(OutdoorAvg)).get(),
+			Zone::Gains::p(Params::active), Zone::Gains::i(Params::active),
+			Zone::Gains::d(Params::active)),
+			indoor(Params::active.indoorTarget), outdoor(OutdoorAvg) {}
+	// reload gains after Params::apply()
+	void configure() {
+		const Settings& s = Params::active;
+		regul.setGains(Zone::Gains::p(s), Zone::Gains::i(s), Zone::Gains::d(s));
+	}
+	bool step(const Sensors::Frame& frame, Clock::clock_t now) {
+		// power-on values are already dropped by Sensors::Filters
+		if (frame.isFresh(Zone::Feed, now)) {
 			failCount = 0;
-			current = value;
-		} else if (indoorSensor == addr) {
-			indoor = value;
-		} else if (outdoorSensor == addr) {
-			outdoor = value;
+			current = frame[Zone::Feed].value;
+		}
+		const Settings& s = Params::active;
+		// room and outdoor temperatures fall back to defaults when too old
+		indoor = frame.isFresh(Zone::Room, now) ? frame[Zone::Room].value : s.indoorTarget;
+		if (frame.isFresh(Zone::Outdoor, now)) {
+			outdoor = frame[Zone::Outdoor].value;
+			history.put(outdoor, now);
+		} else {
+			outdoor = history.last(OutdoorAvg);
 		}
-	}
-	bool step() {
-		input_t target = Zero - outdoor / k + (IndoorTarget - indoor) * 4;
-		if (target < Min) target = Min;
-		if (target > Max) target = Max;
-		regul.setTarget(target);
 
-		indoor = IndoorTarget;
-		outdoor = OutdoorAvg;
+		Temperature ahead = history.predict(Temperature(outdoor), s.radiatorLead);
+		Temperature target = HeatingCurve::feed(ahead)
+				+ TemperatureDelta(s.radiatorShift + Zone::Shift)
+				+ (Temperature(s.indoorTarget) - Temperature(indoor)) * int8_t(s.radiatorRoomK);
+		regul.setTarget(target.clamp(Temperature(Min), Temperature(Max)).get());
 
-		bool ret = parent_t::step();
+		bool ret = parent_t::step(now);
 		return ret;
 	}
 	template <class S>
 	S& log(S& s) const {
 		parent_t::log(s);
-		s << "\nTemp: radiatorValve=" << regul.getOutput();
+		s << "\nTemp: " << Zone::name() << "Valve=" << regul.getOutput();
+		s << "\nTemp: " << Zone::name() << "Trend=" << TemperatureDelta(history.trend()) << "/h";
 		return s;
 	}
 
 private:
+	using parent_t::failCount;
+	using parent_t::current;
+	using parent_t::regul;
+
 	input_t indoor;
 	input_t outdoor;
-	OneWire::ConstAddr<0x28, 0xD9, 0xF8, 0xD5, 0x03, 0x00, 0x00, 0xB0> radiatorSensor;
-	OneWire::ConstAddr<0x28, 0x0A, 0xFB, 0xD5, 0x03, 0x00, 0x00, 0x63> outdoorSensor;
-	OneWire::ConstAddr<0x28, 0xC3, 0xE0, 0xD5, 0x03, 0x00, 0x00, 0x66> indoorSensor;
+	OutdoorTrend history;
 };
 
-typedef Cascade<Regul<int16_t, 4000, -4000>, Action<Data, 4, 5>> BoilerCascadeParent;
-class BoilerCascade: public BoilerCascadeParent {
+struct BoilerDefaults {
+	static const int16_t Target = (50_C).get();
+	static const int16_t MaxOut = (95_C).get();
+	static const int16_t MinOut = (50_C).get();
+	static const int16_t MaxDelta = (35_K).get(); // default of Settings::boilerMaxDelta
+	static const int16_t MinDelta = (4_K).get();
+	static const int16_t TCHigh = (60_C).get();
+};
+
+/**
+ * Boiler zone, mixing valve keeps return temperature of the boiler
+ * within boilerMaxDelta of its output, the pump disconnects a cold boiler.
+ * Zone is a configuration, see Zones.h.
+ */
+template <class Zone>
+class BoilerCascade: public Cascade<Regul<int16_t, 4000, -4000>, typename Zone::Valve, Zone::Period>,
+		public BoilerDefaults {
 public:
-	typedef BoilerCascadeParent parent_t;
-	using parent_t::input_t;
-	const static input_t Target = Temperature::toInt(50);
-	const static input_t MaxOut = Temperature::toInt(95);
-	const static input_t MinOut = Temperature::toInt(50);
-	const static input_t MaxDelta = Temperature::toInt(35);
-	const static input_t MinDelta = Temperature::toInt(4);
-	const static input_t TCHigh = Temperature::toInt(60);
-	BoilerCascade() :  parent_t(Target, 4), inTemp(0), outTemp(0), outAvg(0), tc(0),
-			readInTemp(false), readOutTemp(false) {}
-	void processSensor(const OneWire::Addr& addr, input_t value) {
-		if (boilerInSensor == addr) {
-			inTemp = value;
-			readInTemp = true;
-		} else if (boilerOutSensor == addr) {
-			outTemp = value;
-			readOutTemp = true;
-			outAvg = (outAvg + outTemp + 1) / 2;
-		}
-	}
-	void processTC(input_t value) {
-		tc = value;
+	typedef Cascade<Regul<int16_t, 4000, -4000>, typename Zone::Valve, Zone::Period> parent_t;
+	typedef typename parent_t::input_t input_t;
+	struct State: parent_t::State {
+		input_t inTemp;
+		input_t outTemp;
+		input_t outPrev;
+		input_t tc;
+	};
+	typedef Zone zone_t;
+
+	BoilerCascade() :  parent_t(Target, Zone::Gains::p(Params::active),
+			Zone::Gains::i(Params::active), Zone::Gains::d(Params::active)),
+			inTemp(0), outTemp(0), outPrev(0), tc(0), outTime(0) {}
+	// reload gains after Params::apply()
+	void configure() {
+		const Settings& s = Params::active;
+		regul.setGains(Zone::Gains::p(s), Zone::Gains::i(s), Zone::Gains::d(s));
 	}
-	bool step() {
+	bool step(const Sensors::Frame& frame, Clock::clock_t now) {
+		bool readInTemp = frame.isFresh(Zone::In, now);
+		bool readOutTemp = frame.isFresh(Zone::Out, now);
 		if (readInTemp && readOutTemp)
 			failCount = 0;
-		if (!readInTemp) {
+		if (readInTemp) {
+			inTemp = frame[Zone::In].value;
+		} else {
 			failCount++;
 		}
-		readInTemp = false;
-		if (!readOutTemp) {
+		if (readOutTemp) {
+			const Sensors::Reading& r = frame[Zone::Out];
+			if (r.time != outTime) {
+				// trend of filtered samples, new samples only
+				outTime = r.time;
+				outPrev = outTemp;
+			}
+			outTemp = r.value;
+		} else {
 			failCount++;
 		}
-		readOutTemp = false;
-		if (inTemp + Temperature::toInt(64) < outTemp) {
+		// too old termocouple keeps the last value
+		if (frame.isFresh(Zone::Flame, now))
+			tc = frame[Zone::Flame].value;
+		Temperature in(inTemp);
+		Temperature out(outTemp);
+		if (in + 64_K < out) {
 			// in/out temperature delta is too big, something wrong. Use only out temp.
 			inTemp = outTemp;
+			in = out;
 			failCount++;
 		}
-		input_t deltaTarget;
+		TemperatureDelta minDelta(MinDelta);
+		Temperature deltaTarget;
 		if ((tc < TCHigh
 				&& outTemp < MinOut  // boiler is not too hot
 				&& failCount == 0    // no errors
-				&& outTemp <= outAvg // boiler is cooling
-				&& inTemp + MinDelta > outTemp // boiler does not produce heat
+				&& outTemp <= outPrev // boiler is cooling
+				&& in + minDelta > out // boiler does not produce heat
 				)
 			) {
 			// Boiler stops, disconnect it from pipes
-			deltaTarget = max(outTemp - MinDelta, inTemp + MinDelta);
+			deltaTarget = Temperature::max(out - minDelta, in + minDelta);
 			pump.stop();
 		} else {
-			deltaTarget = max(outTemp - MaxDelta, Target);
+			deltaTarget = Temperature::max(out - TemperatureDelta(Params::active.boilerMaxDelta),
+					Temperature(Target));
 			pump.start();
 		}
-		regul.setTarget(deltaTarget);
+		regul.setTarget(deltaTarget.get());
 		current = inTemp;
 
-		bool ret = parent_t::step();
+		bool ret = parent_t::step(now);
 		return ret;
 	}
+	void save(State& s) const {
+		parent_t::save(s);
+		s.inTemp = inTemp;
+		s.outTemp = outTemp;
+		s.outPrev = outPrev;
+		s.tc = tc;
+	}
+	void restore(const State& s) {
+		parent_t::restore(s);
+		inTemp = s.inTemp;
+		outTemp = s.outTemp;
+		outPrev = s.outPrev;
+		tc = s.tc;
+	}
 	template <class S>
 	S& log(S& s) const {
 		parent_t::log(s);
 		s << "\nTemp: pump=" << pump.status();
-		s << "\nTemp: boilerValve=" << regul.getOutput();
-		s << "\nTemp: boilerDelta=" << Temperature(outTemp - inTemp);
+		s << "\nTemp: " << Zone::name() << "Valve=" << regul.getOutput();
+		s << "\nTemp: " << Zone::name() << "Delta=" << Temperature(outTemp) - Temperature(inTemp);
 		return s;
 	}
 private:
-	input_t max( input_t a, input_t b)
-	{
-		return a > b ? a:b;
-	}
-	OneWire::ConstAddr<0x28, 0x8D, 0x2E, 0x8E, 0x05, 0x00, 0x00, 0x1D> boilerOutSensor;
-	OneWire::ConstAddr<0x28, 0x50, 0x05, 0xD6, 0x03, 0x00, 0x00, 0x0E> boilerInSensor;
+	using parent_t::failCount;
+	using parent_t::current;
+	using parent_t::regul;
+
 	input_t inTemp;
 	input_t outTemp;
-	input_t outAvg;
+	input_t outPrev;
 	input_t tc; // termocouple
-	Action<Data, 3> pump;
-	bool readInTemp;
-	bool readOutTemp;
+	Clock::clock_t outTime;
+	typename Zone::Pump pump;
 };
 
 #endif /* CASCADE_H_ */
@@ -12,6 +12,7 @@
 #include <atomic.h>
 
 #include "Clock.h"
+#include "Queue.h"
 
 // TODO code from arduino
 
@@ -29,12 +30,12 @@
 #define FRACT_INC ((MICROSECONDS_PER_TIMER0_OVERFLOW % 1000) >> 3)
 #define FRACT_MAX (1000 >> 3)
 
-static volatile Clock::clock_t mills;
-static volatile uint8_t frac;
+static Lockfree::Shared<Clock::clock_t> mills;
+static uint8_t frac; // ISR only
 
 ISR(TIMER0_OVF_vect)
 {
-	Clock::clock_t m = mills;
+	Clock::clock_t m = mills.get();
 	uint8_t f = frac;
 
 	m += MILLIS_INC;
@@ -43,7 +44,7 @@ ISR(TIMER0_OVF_vect)
 		f -= FRACT_MAX;
 		++m;
 	}
-	mills = m;
+	mills.set(m);
 	frac = f;
 }
 
@@ -53,6 +54,5 @@ void Clock::start() {
 }
 
 Clock::clock_t Clock::millis() {
-	Atomic::DisableInterrupts di;
-	return mills;
+	return mills.get();
 }
@@ -8,14 +8,19 @@
 #ifndef CLOCK_H_
 #define CLOCK_H_
 
+#include <inttypes.h>
+#include <avr/io.h>
 
 class Clock {
 public:
-	typedef uint16_t clock_t;
+	typedef uint32_t clock_t; // ms, wraps in 49 days
 	typedef void (*func)();
 
 	static void start();
 	static clock_t millis();
+	// free running Timer0 count for short intervals, wraps in 256 ticks
+	static uint8_t ticks() { return TCNT0; }
+	static const uint8_t TickMicros = 64 * 1000000UL / F_CPU;
 };
 
 
@@ -0,0 +1,231 @@
+#ifndef CONSOLE_H_
+#define CONSOLE_H_
+
+#include <inttypes.h>
+
+#include "Params.h"
+#include "Autotune.h"
+#include "HeatingCurve.h"
+#include "Stats.h"
+#include "temperature.h"
+
+/**
+ * Line based command interface over serial port.
+ * Line is split in place, no copies of arguments are made.
+ *
+ *   list              - print all parameters
+ *   get <name>        - print parameter
+ *   set <name> <val>  - change parameter, applied at next cycle
+ *   save              - store parameters to EEPROM
+ *   defaults          - restore default parameters
+ *   tune <zone>       - relay autotune of zone gains, zones are in Zones.h
+ *   tune off          - stop autotune
+ *   curve             - print heating curve points
+ *   curve <out> <feed> - change curve point nearest to outdoor temperature
+ *   curve save        - store curve to EEPROM
+ *   curve reset       - built in curve, applied at once
+ *   stats             - print counters, see Stats
+ *   stats reset       - zero counters
+ *
+ * Temperatures are in degrees with optional fraction: "22.5".
+ */
+template <class Port, class Zones>
+class Console {
+public:
+	Console(Port& port) : port(port), len(0) {}
+
+	// execute received commands, does not block
+	void poll() {
+		char c;
+		while (port.read(c)) {
+			if (c == '\r' || c == '\n') {
+				if (len > 0 && len < Size) {
+					line[len] = 0;
+					execute();
+				} else if (len == Size) {
+					port << "Error: too long" << endl;
+				}
+				len = 0;
+			} else if (len < Size - 1) {
+				line[len++] = c;
+			} else {
+				len = Size; // skip rest of line
+			}
+		}
+	}
+private:
+	static const uint8_t Size = 32;
+	static const uint8_t MaxArgs = 3;
+
+	void execute() {
+		char* argv[MaxArgs];
+		uint8_t argc = split(argv);
+		if (argc == 0)
+			return;
+		if (equal(argv[0], "list") && argc == 1) {
+			for (uint8_t i = 0; i < Params::Count; ++i)
+				print(i);
+			return;
+		}
+		if (equal(argv[0], "save") && argc == 1) {
+			Params::save();
+			port << "Saved" << endl;
+			return;
+		}
+		if (equal(argv[0], "defaults") && argc == 1) {
+			Params::defaults();
+			port << "Defaults" << endl;
+			return;
+		}
+		if (equal(argv[0], "tune") && argc == 2) {
+			int8_t z = Zones::find(argv[1]);
+			if (equal(argv[1], "off"))
+				Autotune::request = Autotune::StopTuning;
+			else if (z >= 0)
+				Autotune::request = Autotune::TuneZone + z;
+			else {
+				port << "Error: unknown zone" << endl;
+				return;
+			}
+			port << "Tune " << argv[1] << endl;
+			return;
+		}
+		if (equal(argv[0], "stats") && argc == 1) {
+			Stats::log(port);
+			return;
+		}
+		if (equal(argv[0], "stats") && argc == 2 && equal(argv[1], "reset")) {
+			Stats::reset();
+			port << "Reset" << endl;
+			return;
+		}
+		if (equal(argv[0], "curve")) {
+			curve(argc, argv);
+			return;
+		}
+		int8_t i = argc > 1 ? Params::find(argv[1]) : -1;
+		if ((equal(argv[0], "get") || equal(argv[0], "set")) && i < 0) {
+			port << "Error: unknown parameter" << endl;
+			return;
+		}
+		if (equal(argv[0], "get") && argc == 2) {
+			print(i);
+			return;
+		}
+		if (equal(argv[0], "set") && argc == 3) {
+			int16_t v;
+			if (!parse(argv[2], Params::entry(i).type == Params::Temp, v)
+					|| !Params::set(i, v)) {
+				port << "Error: bad value" << endl;
+				return;
+			}
+			print(i);
+			return;
+		}
+		port << "Error: bad command" << endl;
+	}
+
+	void curve(uint8_t argc, char** argv) {
+		if (argc == 1) {
+			for (uint8_t i = 0; i < HeatingCurve::Points; ++i)
+				port << HeatingCurve::outdoorOf(i) << '=' << Temperature(HeatingCurve::point(i)) << endl;
+			port << (HeatingCurve::isOverridden() ? "Changed" : "Built in") << endl;
+			return;
+		}
+		if (argc == 2 && equal(argv[1], "save")) {
+			HeatingCurve::save();
+			port << "Saved" << endl;
+			return;
+		}
+		if (argc == 2 && equal(argv[1], "reset")) {
+			HeatingCurve::reset();
+			port << "Built in" << endl;
+			return;
+		}
+		int16_t out, feed;
+		if (argc != 3 || !parse(argv[1], true, out) || !parse(argv[2], true, feed)
+				|| feed < (20_C).get() || feed > (90_C).get()) {
+			port << "Error: bad value" << endl;
+			return;
+		}
+		int16_t o = out - HeatingCurve::Lo + HeatingCurve::Step / 2;
+		uint8_t i = o < 0 ? 0 : o >> HeatingCurve::StepShift;
+		if (i >= HeatingCurve::Points)
+			i = HeatingCurve::Points - 1;
+		HeatingCurve::set(i, feed);
+		port << HeatingCurve::outdoorOf(i) << '=' << Temperature(feed) << endl;
+	}
+
+	void print(uint8_t i) {
+		Params::Entry e = Params::entry(i);
+		int16_t v = Params::get(i);
+		port << e.name << '=';
+		if (e.type == Params::Temp)
+			port << Temperature(v);
+		else if (e.type == Params::I16)
+			port << int(v);
+		else
+			port << (unsigned int)(uint16_t)v;
+		port << endl;
+	}
+
+	uint8_t split(char** argv) {
+		uint8_t argc = 0;
+		char* p = line;
+		for (;;) {
+			while (*p == ' ')
+				*p++ = 0;
+			if (*p == 0)
+				return argc;
+			if (argc == MaxArgs)
+				return MaxArgs + 1;
+			argv[argc++] = p;
+			while (*p != ' ' && *p != 0)
+				++p;
+		}
+	}
+
+	static bool equal(const char* a, const char* b) {
+		while (*a && *a == *b) {
+			++a;
+			++b;
+		}
+		return *a == *b;
+	}
+
+	// integer, or temperature with one optional fraction digit
+	static bool parse(const char* s, bool temperature, int16_t& value) {
+		bool negative = *s == '-';
+		if (negative)
+			++s;
+		if (*s == 0)
+			return false;
+		int32_t v = 0;
+		for (; *s >= '0' && *s <= '9'; ++s) {
+			v = v * 10 + (*s - '0');
+			if (v > 32767)
+				return false;
+		}
+		if (temperature) {
+			v *= 16;
+			if (*s == '.') {
+				++s;
+				if (*s < '0' || *s > '9')
+					return false;
+				v += ((*s++ - '0') * 16 + 5) / 10;
+			}
+			if (v > 32767)
+				return false;
+		}
+		if (*s != 0)
+			return false;
+		value = negative ? -v : v;
+		return true;
+	}
+
+	Port& port;
+	uint8_t len;
+	char line[Size];
+};
+
+#endif /* CONSOLE_H_ */
@@ -0,0 +1,82 @@
+#ifndef EEPROM_H_
+#define EEPROM_H_
+
+#include <inttypes.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+// EEPROM map of ATmega328 (1024 bytes)
+namespace EepromLayout {
+enum : uint16_t {
+	WarmStart = 0x000, // EepromRing<WarmStart, 4 slots>
+	Params = 0x300,    // EepromRing<Settings, 2 slots>
+	Curve = 0x340,     // EepromRing<CurveOverride, 2 slots>
+	Stats = 0x390,     // EepromRing<Counters, 2 slots>
+	End = E2END + 1
+};
+}
+
+/**
+ * Wear levelled ring of Slots copies of T at Base.
+ * Each slot is [seq][T][crc]. save() writes the slot after the newest one,
+ * load() picks the newest slot with valid crc.
+ * Version is mixed into crc, so changed layout of T invalidates old data.
+ */
+template <class T, uint16_t Base, uint8_t Slots, uint8_t Version = 1>
+class EepromRing {
+public:
+	static const uint16_t SlotSize = sizeof(T) + 2;
+	static const uint16_t Size = SlotSize * Slots;
+	static_assert(Slots > 0 && Slots < 128, "bad slot count");
+
+	EepromRing() : slot(Slots - 1), seq(0) {}
+
+	// returns false if there is no valid copy
+	bool load(T& value) {
+		bool found = false;
+		for (uint8_t i = 0; i < Slots; ++i) {
+			T tmp;
+			uint8_t s;
+			if (!read(i, s, tmp))
+				continue;
+			if (found && int8_t(s - seq) <= 0)
+				continue;
+			found = true;
+			slot = i;
+			seq = s;
+			value = tmp;
+		}
+		return found;
+	}
+	void save(const T& value) {
+		if (++slot >= Slots)
+			slot = 0;
+		++seq;
+		uint8_t* p = addr(slot);
+		eeprom_update_byte(p, seq);
+		eeprom_update_block(&value, p + 1, sizeof(T));
+		eeprom_update_byte(p + 1 + sizeof(T), crc(seq, &value));
+	}
+private:
+	static uint8_t* addr(uint8_t i) {
+		return reinterpret_cast<uint8_t*>(Base + uint16_t(i) * SlotSize);
+	}
+	static uint8_t crc(uint8_t s, const T* value) {
+		uint8_t c = _crc_ibutton_update(Version, s);
+		const uint8_t* b = reinterpret_cast<const uint8_t*>(value);
+		for (uint16_t i = 0; i < sizeof(T); ++i)
+			c = _crc_ibutton_update(c, b[i]);
+		return c;
+	}
+	static bool read(uint8_t i, uint8_t& s, T& value) {
+		const uint8_t* p = addr(i);
+		s = eeprom_read_byte(p);
+		eeprom_read_block(&value, p + 1, sizeof(T));
+		return eeprom_read_byte(p + 1 + sizeof(T)) == crc(s, &value);
+	}
+
+	uint8_t slot;
+	uint8_t seq;
+};
+
+#endif /* EEPROM_H_ */
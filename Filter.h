@@ -0,0 +1,171 @@
+#ifndef FILTER_H_
+#define FILTER_H_
+
+#include <inttypes.h>
+
+#include "Clock.h"
+#include "Sensors.h"
+#include "temperature.h"
+
+/**
+ * Filter chain of one sensor, fixed point, constant RAM.
+ * Stages run in order, each one is enabled by Config:
+ *   PowerOn - drop 85 degree reset value of DS18x20 unless previous
+ *             value is near it or it repeats PowerOnRepeat times
+ *   Median  - median of the last 3 samples, removes single spikes
+ *   Rate    - limit change to maxRate per second since previous sample
+ *   Ewma    - y += (x - y) / 2^shift
+ */
+class Filter {
+public:
+	enum Stage : uint8_t {
+		PowerOn = 1,
+		Median = 2,
+		Rate = 4,
+		Ewma = 8
+	};
+	struct Config {
+		uint8_t stages;
+		uint8_t shift;   // of Ewma
+		int16_t maxRate; // 1/16 degree per second
+	};
+	static const int16_t PowerOnValue = (85_C).get();
+	static const int16_t PowerOnBand = (20_K).get();
+	static const uint8_t PowerOnRepeat = 3;
+	static const uint8_t AccBits = 4; // extra bits of Ewma accumulator, by multiply: x may be negative
+
+	Filter() : count(0), repeat(0) {}
+
+	// returns false if sample is dropped, value is then unchanged
+	bool put(int16_t x, Clock::clock_t now, const Config& c, int16_t& value) {
+		if (x != PowerOnValue)
+			repeat = 0;
+		else if (repeat < PowerOnRepeat)
+			++repeat;
+		if ((c.stages & PowerOn) && repeat > 0 && repeat < PowerOnRepeat
+				&& !(count > 0 && abs(PowerOnValue - out) <= PowerOnBand))
+			return false;
+		if (c.stages & Median) {
+			int16_t m = x;
+			if (count > 1)
+				m = median(x, last[0], last[1]);
+			last[1] = last[0];
+			last[0] = x;
+			x = m;
+		}
+		if (count == 0) {
+			acc = int32_t(x) * (1 << AccBits);
+		} else {
+			if (c.stages & Rate) {
+				uint32_t seconds = (now - time + 999) / 1000;
+				int32_t limit = seconds * c.maxRate;
+				int32_t d = int32_t(x) - out;
+				if (d > limit)
+					x = out + limit;
+				else if (d < -limit)
+					x = out - limit;
+			}
+			if (c.stages & Ewma) {
+				int32_t d = int32_t(x) * (1 << AccBits) - acc;
+				acc += d >= 0 ? d >> c.shift : -(-d >> c.shift);
+			} else {
+				acc = int32_t(x) * (1 << AccBits);
+			}
+		}
+		out = (acc + (1 << (AccBits - 1))) >> AccBits;
+		time = now;
+		if (count < 2)
+			++count;
+		value = out;
+		return true;
+	}
+	// drop history, next sample starts the chain again
+	void reset() {
+		count = 0;
+		repeat = 0;
+	}
+private:
+	static int16_t abs(int16_t v) {
+		return v < 0 ? -v : v;
+	}
+	static int16_t median(int16_t a, int16_t b, int16_t c) {
+		if (a > b) {
+			int16_t t = a;
+			a = b;
+			b = t;
+		}
+		// a <= b
+		return c <= a ? a : c >= b ? b : c;
+	}
+
+	int32_t acc;
+	Clock::clock_t time;
+	int16_t last[2];
+	int16_t out;
+	uint8_t count;  // samples in last[], up to 2
+	uint8_t repeat; // power-on values in a row
+};
+
+namespace Sensors {
+
+// filter stages by role
+inline Filter::Config filterOf(Role role) {
+	Filter::Config c;
+	switch (role) {
+	case Thermocouple:
+	case Flue:
+		// follows flame, only spikes are removed
+		c.stages = Filter::Median;
+		c.shift = 0;
+		c.maxRate = 0;
+		return c;
+	case BoilerIn:
+	case BoilerOut:
+		c.stages = Filter::PowerOn | Filter::Median | Filter::Rate | Filter::Ewma;
+		c.shift = 1;
+		c.maxRate = (2_K).get();
+		return c;
+	case Radiator:
+	case HeatOutput:
+		c.stages = Filter::PowerOn | Filter::Median | Filter::Rate | Filter::Ewma;
+		c.shift = 1;
+		c.maxRate = (1_K).get();
+		return c;
+	default:
+		c.stages = Filter::PowerOn | Filter::Median | Filter::Rate | Filter::Ewma;
+		c.shift = 2;
+		c.maxRate = (0.25_K).get();
+		return c;
+	}
+}
+
+/**
+ * Filters of all roles.
+ *
+ * Example
+ *
+ * 		int16_t v;
+ * 		if (filters.put(role, t.get(), now, v))
+ * 			snapshot.put(role, v, now);
+ */
+class Filters {
+public:
+	// unknown devices are not filtered
+	bool put(Role r, int16_t x, Clock::clock_t now, int16_t& value) {
+		if (r >= Other) {
+			value = x;
+			return true;
+		}
+		return filter[r].put(x, now, filterOf(r), value);
+	}
+	void reset(Role r) {
+		if (r < Other)
+			filter[r].reset();
+	}
+private:
+	Filter filter[Other];
+};
+
+} // namespace Sensors
+
+#endif /* FILTER_H_ */
@@ -0,0 +1,119 @@
+#ifndef FORMAT_H_
+#define FORMAT_H_
+
+#include <inttypes.h>
+
+/**
+ * Number to text without division, AVR has no divide instruction and
+ * library division takes hundreds of cycles per digit. Digits are written
+ * backwards from the end of a caller's buffer, nothing is allocated.
+ * Stream manipulators set width, fill and base of the next output.
+ *
+ * Example
+ *
+ * 		com << Format::width(5) << Format::fill('0') << n;
+ * 		com << Format::hex << 0xBEEFUL << Format::dec;
+ */
+namespace Format {
+
+const uint8_t MaxDigits = 10; // of 32 bit decimal
+
+struct Width { uint8_t n; };
+struct Fill { char c; };
+struct Base { uint8_t n; };
+
+// minimal characters of the next number or string
+inline Width width(uint8_t n) { return Width{n}; }
+// pad character, '0' goes after the sign
+inline Fill fill(char c) { return Fill{c}; }
+// base of the following numbers, 10 or 16, uint8_t is always 2 hex digits
+const Base dec = {10};
+const Base hex = {16};
+
+inline char digit(uint8_t d) {
+	return d < 10 ? '0' + d : 'A' - 10 + d;
+}
+
+// n / 10 by shifts and adds (Hacker's Delight 10-17), r is the remainder
+inline uint32_t div10(uint32_t n, uint8_t& r) {
+	uint32_t q = (n >> 1) + (n >> 2);
+	q += q >> 4;
+	q += q >> 8;
+	q += q >> 16;
+	q >>= 3;
+	r = n - ((q << 3) + (q << 1));
+	if (r > 9) {
+		++q;
+		r -= 10;
+	}
+	return q;
+}
+
+inline uint16_t div10(uint16_t n, uint8_t& r) {
+	uint16_t q = (n >> 1) + (n >> 2);
+	q += q >> 4;
+	q += q >> 8;
+	q >>= 3;
+	r = n - ((q << 3) + (q << 1));
+	if (r > 9) {
+		++q;
+		r -= 10;
+	}
+	return q;
+}
+
+// returns first digit, at least one
+inline char* toDecimal(uint16_t n, char* end) {
+	do {
+		uint8_t r;
+		n = div10(n, r);
+		*--end = '0' + r;
+	} while (n);
+	return end;
+}
+
+// 16 bit steps once the value fits
+inline char* toDecimal(uint32_t n, char* end) {
+	while (n > 0xFFFF) {
+		uint8_t r;
+		n = div10(n, r);
+		*--end = '0' + r;
+	}
+	return toDecimal(uint16_t(n), end);
+}
+
+inline char* toHex(uint32_t n, char* end) {
+	do {
+		*--end = digit(n & 15);
+		n >>= 4;
+	} while (n);
+	return end;
+}
+
+// s with sign, padded to width, each character by out.put(c)
+template <class Out>
+void pad(Out& out, const char* s, uint8_t len, bool negative, uint8_t width, char fill) {
+	if (negative && fill == '0')
+		out.put('-');
+	for (; width > len + negative; --width)
+		out.put(fill);
+	if (negative && fill != '0')
+		out.put('-');
+	while (len--)
+		out.put(*s++);
+}
+
+// 16 bit steps for values that fit
+template <class Out>
+void number(Out& out, uint32_t n, bool negative, uint8_t width, char fill, uint8_t base) {
+	char buf[MaxDigits];
+	char* end = buf + sizeof(buf);
+	char* p = base == 16 ? toHex(n, end)
+			: n <= 0xFFFF ? toDecimal(uint16_t(n), end)
+			: toDecimal(n, end);
+	pad(out, p, end - p, negative, width, fill);
+}
+
+} // namespace Format
+
+#endif /* FORMAT_H_ */
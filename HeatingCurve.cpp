@@ -0,0 +1,88 @@
+#include <avr/pgmspace.h>
+
+#include "HeatingCurve.h"
+#include "Eeprom.h"
+
+typedef long double real;
+
+constexpr real Ln2 = 0.693147180559945309417L;
+
+// 2 * atanh(y) series of ln((1 + y) / (1 - y)), term is y^k
+constexpr real lnSeries(real y2, real term, uint8_t k, uint8_t n) {
+	return n == 0 ? 0 : term / k + lnSeries(y2, term * y2, k + 2, n - 1);
+}
+// x is reduced to 1..2 by powers of 2
+constexpr real ln(real x) {
+	return x > 2 ? ln(x / 2) + Ln2 : x < 1 ? ln(x * 2) - Ln2
+			: 2 * lnSeries(((x - 1) / (x + 1)) * ((x - 1) / (x + 1)), (x - 1) / (x + 1), 1, 16);
+}
+// Taylor series, term is z^k / k!
+constexpr real expSeries(real z, real term, uint8_t k, uint8_t n) {
+	return n == 0 ? 0 : term + expSeries(z, term * z / k, k + 1, n - 1);
+}
+constexpr real exponent(real z) {
+	return expSeries(z, 1, 1, 40);
+}
+// x^0.77, z = 0.77 ln(x) is within -3..0.2 on the curve
+constexpr real shape(real x) {
+	return x <= 0 ? 0 : exponent(0.77L * ln(x));
+}
+constexpr int16_t point(uint8_t i) {
+	return Temperature::fromCelsius(HeatingCurve::Room + (HeatingCurve::Feed - HeatingCurve::Room)
+			* shape((HeatingCurve::Room - (HeatingCurve::Lo + i * HeatingCurve::Step) / 16.0)
+					/ (HeatingCurve::Room - HeatingCurve::Outdoor))).get();
+}
+
+static const int16_t flash[HeatingCurve::Points] PROGMEM = {
+	point(0), point(1), point(2), point(3), point(4),
+	point(5), point(6), point(7), point(8), point(9),
+	point(10), point(11), point(12), point(13), point(14)
+};
+static_assert(sizeof(flash) / sizeof(flash[0]) == HeatingCurve::Points, "curve size");
+static_assert(point(3) == Temperature::fromCelsius(HeatingCurve::Feed).get(), "curve at design outdoor");
+
+struct CurveOverride {
+	bool overridden;
+	int16_t points[HeatingCurve::Points];
+};
+typedef EepromRing<CurveOverride, EepromLayout::Curve, 2> CurveRing;
+static_assert(EepromLayout::Curve + CurveRing::Size <= EepromLayout::Stats,
+		"curve does not fit EEPROM");
+static CurveRing ring;
+
+int16_t HeatingCurve::ram[HeatingCurve::Points];
+bool HeatingCurve::overridden = false;
+
+void HeatingCurve::init() {
+	CurveOverride c;
+	if (ring.load(c) && c.overridden) {
+		for (uint8_t i = 0; i < Points; ++i)
+			ram[i] = c.points[i];
+		overridden = true;
+	}
+}
+
+int16_t HeatingCurve::point(uint8_t i) {
+	return overridden ? ram[i] : int16_t(pgm_read_word(&flash[i]));
+}
+
+void HeatingCurve::set(uint8_t i, int16_t value) {
+	if (!overridden) {
+		for (uint8_t k = 0; k < Points; ++k)
+			ram[k] = pgm_read_word(&flash[k]);
+		overridden = true;
+	}
+	ram[i] = value;
+}
+
+void HeatingCurve::reset() {
+	overridden = false;
+}
+
+void HeatingCurve::save() {
+	CurveOverride c;
+	c.overridden = overridden;
+	for (uint8_t i = 0; i < Points; ++i)
+		c.points[i] = point(i);
+	ring.save(c);
+}
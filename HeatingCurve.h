@@ -0,0 +1,57 @@
+#ifndef HEATINGCURVE_H_
+#define HEATINGCURVE_H_
+
+#include <inttypes.h>
+
+#include "temperature.h"
+
+/**
+ * Radiator feed temperature by outdoor temperature.
+ * Points are every 4 degree from -32 to +24, generated at compile time
+ * into flash from radiator curve with exponent ~1.3:
+ *   feed = Room + (Feed - Room) * x^0.77, x = (Room - outdoor) / (Room - Outdoor)
+ * where Feed is design feed temperature at design Outdoor temperature.
+ * Points can be overridden at runtime, the copy lives in RAM and EEPROM.
+ * Lookup is an index shift and one multiply either way.
+ */
+class HeatingCurve {
+public:
+	static const uint8_t Points = 15;
+	static const int16_t Lo = -32 * 16;   // outdoor of the first point
+	static const uint8_t StepShift = 6;   // 4 degree between points
+	static const int16_t Step = 1 << StepShift;
+
+	// design values of the flash curve
+	constexpr static long double Room = 20;
+	constexpr static long double Outdoor = -20;
+	constexpr static long double Feed = 52;
+
+	// load override from EEPROM
+	static void init();
+	static Temperature feed(Temperature outdoor) {
+		int16_t o = outdoor.get() - Lo;
+		if (o <= 0)
+			return Temperature(point(0));
+		if (o >= (Points - 1) * Step)
+			return Temperature(point(Points - 1));
+		uint8_t i = o >> StepShift;
+		int16_t frac = o & (Step - 1);
+		int16_t y0 = point(i);
+		return Temperature(y0 + (((int32_t(point(i + 1)) - y0) * frac) >> StepShift));
+	}
+	static Temperature outdoorOf(uint8_t i) {
+		return Temperature(Lo + i * Step);
+	}
+	static int16_t point(uint8_t i);
+	// copies flash curve to RAM on the first change
+	static void set(uint8_t i, int16_t value);
+	static bool isOverridden() { return overridden; }
+	// use flash curve again
+	static void reset();
+	static void save();
+private:
+	static int16_t ram[Points];
+	static bool overridden;
+};
+
+#endif /* HEATINGCURVE_H_ */
@@ -0,0 +1,22 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "Idle.h"
+
+uint32_t Idle::residency;
+Clock::clock_t Idle::windowStart;
+
+void Idle::sleep(Clock::clock_t deadline)
+{
+	Clock::clock_t start = Clock::millis();
+	if (int32_t(deadline - start) <= 0)
+		return;
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	cli();
+	sleep_enable();
+	sei(); // next instruction is executed before any interrupt
+	sleep_cpu();
+	sleep_disable();
+	residency += Clock::millis() - start;
+}
@@ -0,0 +1,55 @@
+#ifndef IDLE_H_
+#define IDLE_H_
+
+#include <inttypes.h>
+
+#include "Clock.h"
+
+/**
+ * Sleeps instead of busy waiting.
+ * Idle mode keeps Timer0, USART and TWI running and wakes up on Timer0
+ * overflow every millisecond or on any other interrupt, so received
+ * bytes and queued TWI messages are served while sleeping. Deeper modes
+ * are not used: Power-save stops the USART clock and loses received
+ * bytes, and it needs Timer2 on a 32768 Hz crystal at TOSC1/TOSC2, which
+ * carry the main crystal on Arduino boards.
+ * Time spent sleeping is accumulated for log().
+ *
+ * Example
+ *
+ * 		while (!Idle::isPassed(deadline))
+ * 			Idle::sleep(deadline);
+ */
+class Idle {
+public:
+	static bool isPassed(Clock::clock_t deadline) {
+		return int32_t(Clock::millis() - deadline) >= 0;
+	}
+	// one sleep, returns after any interrupt
+	static void sleep(Clock::clock_t deadline);
+	// percent of time active and asleep since previous log
+	template <class S>
+	static S& log(S& s) {
+		Clock::clock_t now = Clock::millis();
+		uint32_t window = now - windowStart;
+		if (window == 0)
+			window = 1;
+		uint32_t sleeping = residency;
+		if (sleeping > window)
+			sleeping = window;
+		s << "active=" << percent(window - sleeping, window)
+			<< "% idle=" << percent(sleeping, window) << '%';
+		residency = 0;
+		windowStart = now;
+		return s;
+	}
+private:
+	static unsigned int percent(uint32_t part, uint32_t window) {
+		return part * 100 / window;
+	}
+
+	static uint32_t residency; // ms asleep
+	static Clock::clock_t windowStart;
+};
+
+#endif /* IDLE_H_ */
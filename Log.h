@@ -0,0 +1,80 @@
+#ifndef LOG_H_
+#define LOG_H_
+
+#include <inttypes.h>
+
+#include "Params.h"
+
+/**
+ * Text log by channel and level. A statement is compiled only if its level
+ * is up to LOG_LEVEL and its channel is in LOG_CHANNELS, otherwise the
+ * condition is constant false and the strings and calls are dropped.
+ * Compiled channels are switched at runtime by Params "log" mask.
+ *
+ * Build flags
+ *
+ * 		-DLOG_LEVEL=1           errors and warnings only
+ * 		-DLOG_CHANNELS=0x06     sensors and radiator only
+ *
+ * Example
+ *
+ * 		LOG(com, Log::Sensors, Log::Warn) << "Drop  " << addr << endl;
+ *
+ * 		if (LOG_ON(Log::Bus, Log::Info)) {
+ * 			...several statements
+ * 		}
+ */
+namespace Log {
+
+enum Level : uint8_t {
+	Error,
+	Warn,
+	Info,
+	Debug
+};
+
+enum Channel : uint8_t {
+	Bus,       // 1-Wire search and resets
+	Sensors,   // readings and failures
+	Radiator,
+	Boiler,
+	Actuation, // valve pulses and TWI
+	Timing,    // cycle time and idle
+	ChannelCount
+};
+
+const uint8_t All = (1 << ChannelCount) - 1;
+
+} // namespace Log
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL Log::Info
+#endif
+#ifndef LOG_CHANNELS
+#define LOG_CHANNELS Log::All
+#endif
+
+namespace Log {
+
+// a constant, so disabled statements are dropped at any optimization
+template <Channel C, Level L>
+struct Compiled {
+	static const bool value = L <= LOG_LEVEL && (LOG_CHANNELS & (1 << C));
+};
+
+inline bool isEnabled(Channel c) {
+	return Params::active.logMask & (1 << c);
+}
+
+} // namespace Log
+
+// whether the statement of channel and level is compiled and enabled
+#define LOG_ON(channel, level) \
+	(Log::Compiled<channel, level>::value && Log::isEnabled(channel))
+
+// stream expression follows, it is not evaluated if the log is off;
+// a loop, not an if, so an else after the statement is not taken over
+#define LOG(port, channel, level) \
+	for (bool logOn = LOG_ON(channel, level); logOn; logOn = false) port
+
+#endif /* LOG_H_ */
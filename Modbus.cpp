@@ -0,0 +1,161 @@
+#include <avr/pgmspace.h>
+
+#include "Modbus.h"
+
+static_assert(Sensors::RoleCount <= Modbus::Zone - Modbus::Sensor, "roles do not fit input registers");
+static_assert(Modbus::InputCount <= Modbus::Stat, "boiler does not fit input registers");
+
+// CRC-16/MODBUS, reflected 0xA001, generated at compile time
+constexpr uint16_t crcBit(uint16_t c, uint8_t n) {
+	return n == 0 ? c : crcBit(c & 1 ? (c >> 1) ^ 0xA001 : c >> 1, n - 1);
+}
+#define CRC1(i) crcBit(i, 8)
+#define CRC4(i) CRC1(i), CRC1(i + 1), CRC1(i + 2), CRC1(i + 3)
+#define CRC16(i) CRC4(i), CRC4(i + 4), CRC4(i + 8), CRC4(i + 12)
+#define CRC64(i) CRC16(i), CRC16(i + 16), CRC16(i + 32), CRC16(i + 48)
+
+static const uint16_t crcTable[256] PROGMEM = {
+	CRC64(0), CRC64(64), CRC64(128), CRC64(192)
+};
+
+uint16_t Modbus::crc(const uint8_t* p, uint8_t n) {
+	uint16_t c = 0xFFFF;
+	while (n--)
+		c = (c >> 8) ^ pgm_read_word(&crcTable[(c ^ *p++) & 0xFF]);
+	return c;
+}
+
+static uint16_t word(const uint8_t* p) {
+	return uint16_t(p[0]) << 8 | p[1];
+}
+
+static void putWord(uint8_t* p, uint16_t v) {
+	p[0] = v >> 8;
+	p[1] = v;
+}
+
+uint8_t Modbus::take() {
+	uint8_t n = 0;
+	uint8_t addr = buf[0];
+	// broadcast is executed without reply
+	if (!overflow && len >= 4 && crc(buf, len) == 0
+			&& (addr == Params::active.modbusAddr || addr == 0)) {
+		n = process();
+		if (addr == 0)
+			n = 0;
+	}
+	len = 0;
+	overflow = false;
+	return n;
+}
+
+uint8_t Modbus::process() {
+	uint8_t function = buf[1];
+	uint16_t addr = word(buf + 2);
+	uint16_t count = word(buf + 4);
+	uint8_t n;
+	switch (function) {
+	case 3:
+	case 4:
+		if (len != 8)
+			return exception(IllegalValue);
+		if (count == 0 || count > MaxRead)
+			return exception(IllegalValue);
+		for (uint8_t i = 0; i < count; ++i) {
+			int16_t v;
+			if (!read(function, addr + i, v))
+				return exception(IllegalAddress);
+			putWord(buf + 3 + 2 * i, v);
+		}
+		buf[2] = 2 * count;
+		n = 3 + 2 * count;
+		break;
+	case 6: {
+		if (len != 8)
+			return exception(IllegalValue);
+		Exception e = write(addr, count);
+		if (e != NoException)
+			return exception(e);
+		n = 6; // echo
+		break;
+	}
+	case 16:
+		if (count == 0 || buf[6] != 2 * count || len != 9 + 2 * count)
+			return exception(IllegalValue);
+		// all or nothing, values are checked first; Command is run last,
+		// so save stores the Params written with it
+		for (uint8_t i = 0; i < count; ++i) {
+			uint16_t a = addr + i;
+			int16_t v = word(buf + 7 + 2 * i);
+			if (a == Command) {
+				if (v != 1 && v != 2)
+					return exception(IllegalValue);
+				continue;
+			}
+			if (a >= Params::Count)
+				return exception(IllegalAddress);
+			Params::Entry e = Params::entry(a);
+			if (v < e.min || v > e.max)
+				return exception(IllegalValue);
+		}
+		for (uint8_t i = 0; i < count; ++i)
+			if (addr + i != Command)
+				write(addr + i, word(buf + 7 + 2 * i));
+		if (addr <= Command && Command < addr + count)
+			write(Command, word(buf + 7 + 2 * (Command - addr)));
+		n = 6;
+		break;
+	default:
+		return exception(IllegalFunction);
+	}
+	uint16_t c = crc(buf, n);
+	buf[n++] = c;
+	buf[n++] = c >> 8;
+	return n;
+}
+
+uint8_t Modbus::exception(Exception e) {
+	buf[1] |= 0x80;
+	buf[2] = e;
+	uint16_t c = crc(buf, 3);
+	buf[3] = c;
+	buf[4] = c >> 8;
+	return 5;
+}
+
+bool Modbus::read(uint8_t function, uint16_t addr, int16_t& value) const {
+	if (function == 4) {
+		if (addr >= Stat && addr < StatEnd) {
+			uint32_t c = Stats::get(Stats::Counter((addr - Stat) / 2));
+			value = (addr - Stat) & 1 ? c : c >> 16;
+			return true;
+		}
+		if (addr >= InputCount)
+			return false;
+		value = input[addr];
+		return true;
+	}
+	if (addr == Command) {
+		value = 0;
+		return true;
+	}
+	if (addr >= Params::Count)
+		return false;
+	value = Params::get(addr);
+	return true;
+}
+
+Modbus::Exception Modbus::write(uint16_t addr, int16_t value) {
+	if (addr == Command) {
+		if (value == 1)
+			Params::save();
+		else if (value == 2)
+			Params::defaults();
+		else
+			return IllegalValue;
+		return NoException;
+	}
+	if (addr >= Params::Count)
+		return IllegalAddress;
+	return Params::set(addr, value) ? NoException : IllegalValue;
+}
@@ -0,0 +1,108 @@
+#ifndef MODBUS_H_
+#define MODBUS_H_
+
+#include <inttypes.h>
+
+#include "Clock.h"
+#include "Params.h"
+#include "Sensors.h"
+#include "Cascade.h"
+#include "Stats.h"
+#include "serial.h"
+
+/**
+ * Modbus RTU slave on the serial port, enabled by Params mbAddr.
+ * Bytes are queued by USART_RX_vect, which also marks frame starts after
+ * 3.5 character silence; poll() takes a frame once the line is silent
+ * again and answers it at once. Nothing is sent unless asked.
+ *
+ * Functions: 03 read holding, 04 read input, 06 write single,
+ * 16 write multiple registers.
+ *
+ * Input registers, values of the last cycle:
+ *   0..  Sensors::Role, 1/16 degree, Temperature::Error when stale
+ *   16.. CascadeRegister block of each zone, zone 0 first
+ *   48.. Boiler
+ *   64.. Stats counters, high word first, read directly
+ * Holding registers:
+ *   0..  Params in table order, applied at next cycle
+ *   256  Command, write 1 to save Params, 2 for defaults
+ */
+class Modbus {
+public:
+	enum Input : uint8_t {
+		Sensor = 0,
+		Zone = 16,
+		Boiler = 48,
+		BoilerOn = Boiler, // wanted
+		BoilerBurner,      // relay
+		Fails,
+		CycleTime,         // ms of the last busy part of cycle
+		BurnerState,       // Burner::State
+		InputCount,
+		Stat = 64,
+		StatEnd = Stat + 2 * Stats::Count
+	};
+	static const uint16_t Command = 256;
+	enum Exception : uint8_t {
+		NoException,
+		IllegalFunction,
+		IllegalAddress,
+		IllegalValue
+	};
+	static const uint8_t Size = 64; // of frame, up to 27 registers written
+	static const uint8_t MaxRead = (Size - 5) / 2;
+
+	Modbus() : len(0), overflow(false) {
+		for (uint8_t i = 0; i < InputCount; ++i)
+			input[i] = 0;
+	}
+	static bool isEnabled() {
+		return Params::active.modbusAddr != 0;
+	}
+	// answers a complete request, does not block otherwise
+	template <class Port>
+	void poll(Port& port, Clock::clock_t now) {
+		char c;
+		for (;;) {
+			uint8_t start;
+			while (SerialRx::starts.peek(start) && int8_t(start - SerialRx::taken) <= 0) {
+				SerialRx::starts.pop(start);
+				if (start == SerialRx::taken)
+					reply(port, take());
+			}
+			if (!SerialRx::get(c))
+				break;
+			if (len < Size)
+				buf[len++] = c;
+			else
+				overflow = true;
+		}
+		if (len > 0 && now - SerialRx::last.get() > SerialRx::FrameGap)
+			reply(port, take());
+	}
+
+	static uint16_t crc(const uint8_t* p, uint8_t n);
+
+	// filled by main loop each cycle
+	int16_t input[InputCount];
+private:
+	// length of reply in buf, 0 if none
+	uint8_t take();
+	uint8_t process();
+	uint8_t exception(Exception e);
+	bool read(uint8_t function, uint16_t addr, int16_t& value) const;
+	Exception write(uint16_t addr, int16_t value);
+
+	template <class Port>
+	void reply(Port& port, uint8_t n) {
+		for (uint8_t i = 0; i < n; ++i)
+			port.write(buf[i]);
+	}
+
+	uint8_t buf[Size];
+	uint8_t len;
+	bool overflow;
+};
+
+#endif /* MODBUS_H_ */
@@ -4,6 +4,7 @@
 #include <inttypes.h>
 #include <util/delay.h>
 
+#include "Clock.h"
 #include "temperature.h"
 
 namespace OneWire
@@ -48,27 +49,181 @@ struct ConstAddr {
 	}
 };
 
-template <class _Line>
+// counters stop at their maximum
+template <class T>
+inline void saturatingInc(T& c, T n = 1)
+{
+	T x = c + n;
+	c = x < c ? T(~T(0)) : x;
+}
+
+/**
+ * Health of one bus, timings of reset() are measured by Timer0 in
+ * Clock::TickMicros steps. Shorts are resets with the line still low
+ * RiseLimit after release, a slow rise time shows a long or heavily
+ * loaded cable before it fails.
+ */
+struct BusStats {
+	uint16_t resets;
+	uint16_t noPresence;
+	uint16_t shorts;
+	uint16_t riseMax;     // us from release to high
+	uint16_t waitMin;     // us from high to presence pulse, 15..60 of spec
+	uint16_t waitMax;
+	uint16_t presenceMin; // us of presence pulse, 60..240 of spec
+	uint16_t presenceMax;
+	uint16_t searchFails;
+	uint16_t timeouts;    // devices busy beyond DS1820::MaxBusy
+	uint8_t searchError; // Search::ErrCode of the last fail
+	uint8_t failByte;    // of Bus0/Bus1 discrepancy
+	uint8_t failBit;
+};
+
+template <class S>
+S& operator<<(S& s, const BusStats& x)
+{
+	s << "resets=" << x.resets << " noPresence=" << x.noPresence << " shorts=" << x.shorts
+		<< " rise=" << x.riseMax << " wait=" << x.waitMin << ".." << x.waitMax
+		<< " presence=" << x.presenceMin << ".." << x.presenceMax
+		<< " searchFails=" << x.searchFails << " timeouts=" << x.timeouts;
+	if (x.searchFails)
+		s << " last=" << int(x.searchError) << ' ' << int(x.failByte) << ':' << int(x.failBit);
+	return s;
+}
+
+// read failures of one device and its last value, see DS1820::read(addr, stats)
+struct DeviceStats {
+	uint8_t resetFails;
+	uint8_t crcErrors;   // or no answer, or implausible short read
+	uint8_t retries;     // of successful reads
+	uint8_t fails;       // all retries failed
+	int16_t last;        // raw of the last good read, if known
+	bool known;
+	uint8_t sinceFull;   // short reads since the last full one
+	bool isClean() const { return !(resetFails | crcErrors | retries | fails); }
+};
+
+/**
+ * Scratchpad read of DS1820::read():
+ *   ReadFull     - all 9 bytes, CRC checked
+ *   ReadShort    - temperature bytes only, the device is stopped by the
+ *                  reset of the next transaction; checked for range and
+ *                  a step of at most MaxStep from the last good value
+ *   ReadAdaptive - short, but full when there is no last value, every
+ *                  FullEvery reads, and at once after an implausible one
+ */
+enum ReadMode : uint8_t {
+	ReadFull,
+	ReadShort,
+	ReadAdaptive,
+	ReadModeCount
+};
+
+// all devices of a DS1820 type, counters saturate
+struct ReadStats {
+	uint16_t full;
+	uint16_t crcErrors;
+	uint16_t shortReads;
+	uint16_t implausible;
+	uint16_t upgrades;   // adaptive short reads repeated in full
+};
+
+template <class S>
+S& operator<<(S& s, const ReadStats& x)
+{
+	return s << "full=" << x.full << " crc=" << x.crcErrors << " short=" << x.shortReads
+		<< " implausible=" << x.implausible << " upgrades=" << x.upgrades;
+}
+
+template <class S>
+S& operator<<(S& s, const DeviceStats& x)
+{
+	return s << "reset=" << int(x.resetFails) << " crc=" << int(x.crcErrors)
+		<< " retry=" << int(x.retries) << " fail=" << int(x.fails);
+}
+
+// strong pull-up by the data pin itself, driven high as output
+struct LinePullUp {};
+
+/**
+ * Bus on one pin. Strong pull-up powers parasite devices while they
+ * convert or copy scratchpad: PullUp is a pin switching a transistor
+ * to Vcc, Set() is on, or LinePullUp to drive the data pin high.
+ */
+template <class _Line, class _PullUp = LinePullUp>
 class Wire
 {
   public:
 	typedef _Line Line;
+	typedef _PullUp PullUp;
+	static const uint8_t Tick = 2;       // us of delay between samples of reset()
+	static const uint8_t RiseLimit = 10; // us
+	static const uint16_t Window = 480;  // us of presence detect
+
+	static BusStats stats;
+
+    static void strongPullUp(bool on)
+    {
+    	strongPullUp(on, (PullUp*)0);
+    }
+    // samples the line through the whole presence window to time it,
+    // time is of Timer0, interrupts only stretch the samples
     static bool reset(void)
     {
+    	const uint16_t Never = 0xFFFF;
+    	saturatingInc(stats.resets);
     	Line::Clear();
     	Line::SetDirWrite();
     	_delay_us(480);
     	Line::SetDirRead();
-    	_delay_us(10);
-    	if(!Line::IsSet())
+    	uint8_t last = Clock::ticks();
+    	uint16_t t = 0, rise = 0, start = Never, end = Never; // us since release
+    	bool high = false;
+    	while (t < Window)
+    	{
+    		bool level = Line::IsSet();
+    		if (!high) {
+    			if (level) {
+    				high = true;
+    				rise = t;
+    			} else if (t >= RiseLimit) {
+    				break;
+    			}
+    		} else if (!level && start == Never) {
+    			start = t;
+    		} else if (level && start != Never && end == Never) {
+    			end = t;
+    		}
+    		_delay_us(Tick);
+    		uint8_t now = Clock::ticks();
+    		t += uint8_t(now - last) * Clock::TickMicros;
+    		last = now;
+    	}
+    	if (!high) {
+    		saturatingInc(stats.shorts);
     		return false; // bus shorting
-		_delay_us(50);
-		bool devicePresent = !Line::IsSet();
-		_delay_us(420);
-    	return devicePresent;
+    	}
+    	if (rise > stats.riseMax)
+    		stats.riseMax = rise;
+    	if (start == Never) {
+    		saturatingInc(stats.noPresence);
+    		return false;
+    	}
+    	uint16_t wait = start - rise;
+    	uint16_t presence = (end != Never ? end : t) - start;
+    	if (!stats.waitMin || wait < stats.waitMin)
+    		stats.waitMin = wait;
+    	if (wait > stats.waitMax)
+    		stats.waitMax = wait;
+    	if (!stats.presenceMin || presence < stats.presenceMin)
+    		stats.presenceMin = presence;
+    	if (presence > stats.presenceMax)
+    		stats.presenceMax = presence;
+    	return true;
     }
 
-    static bool ioBit(bool bit = true)
+    // powered turns strong pull-up on right after the slot, without recovery time
+    static bool ioBit(bool bit = true, bool powered = false)
     {
     	Line::Clear();
     	Line::SetDirWrite();
@@ -81,7 +236,10 @@ class Wire
     	bit = Line::IsSet();
     	_delay_us(60 -11);
     	Line::SetDirRead();
-    	_delay_us(10);
+    	if (powered)
+    		strongPullUp(true);
+    	else
+    		_delay_us(10);
     	return bit;
     }
 
@@ -97,11 +255,12 @@ class Wire
     	return value;
     }
 
-    static void write(uint8_t value)
+    // powered keeps strong pull-up on after the last bit, see strongPullUp()
+    static void write(uint8_t value, bool powered = false)
     {
     	for (int i = 0; i < 8; ++i)
     	{
-    		ioBit(value & 1);
+    		ioBit(value & 1, powered && i == 7);
     		value >>= 1;
     	}
     }
@@ -144,8 +303,28 @@ class Wire
     	return crc;
     }
 
+  private:
+    static void strongPullUp(bool on, LinePullUp*)
+    {
+    	if (on) {
+    		Line::Set();
+    		Line::SetDirWrite();
+    	} else {
+    		Line::SetDirRead();
+    		Line::Clear();
+    	}
+    }
+    template <class P>
+    static void strongPullUp(bool on, P*)
+    {
+    	P::Set(on);
+    	P::SetDirWrite();
+    }
 };
 
+template <class Line, class PullUp>
+BusStats Wire<Line, PullUp>::stats;
+
 /**
  * Realization of search algorithm
  * Counter is type of holder of last search results.
@@ -179,7 +358,7 @@ public:
     	Addr addr;
     	if (!Wire::reset())
     	{
-    		fail = RESET;
+    		setFail(RESET);
     		return addr;
     	}
     	Wire::write(0xF0);
@@ -196,9 +375,9 @@ public:
 				if (bit && notBit)
 				{
 					// bus failure
-					fail = bit ? BUS1 : BUS0;
 					failByte = bytePos;
 					failBit = curBit;
+					setFail(bit ? BUS1 : BUS0);
 					return addr;
 				}
 				if (!bit && !notBit)
@@ -218,7 +397,7 @@ public:
     			crc = Wire::crc8(addr[bytePos], crc);
     	}
     	if (addr[7] != crc)
-    		fail = CRC;
+    		setFail(CRC);
     	visited = next;
 
     	return addr;
@@ -253,6 +432,16 @@ public:
     }
 
 private:
+	void setFail(ErrCode code)
+	{
+		fail = code;
+		BusStats& s = Wire::stats;
+		saturatingInc(s.searchFails);
+		s.searchError = code;
+		s.failByte = failByte;
+		s.failBit = failBit;
+	}
+
 	ErrCode fail;
 	Counter visited;
 
@@ -260,23 +449,85 @@ private:
 	uint8_t failBit;
 };
 
+/**
+ * DS18B20 and DS18S20 temperature sensors.
+ * Parasite powered devices are found by detectPower(), or all of them
+ * are assumed to be with parasitePower. They convert with strong
+ * pull-up for conversionTime() of the highest resolution read since
+ * the previous convert(), 12 bit until the first read.
+ *
+ * Example
+ *
+ * 		Wire::reset();
+ * 		Wire::skip();
+ * 		DS1820::convert();
+ * 		DS1820::wait(delay_ms);
+ */
 template <class Wire, bool parasitePower = false>
 class DS1820
 {
 public:
+	typedef void (*Sleep)(uint16_t ms);
+	static const uint16_t CopyTime = 10; // ms of copy scratchpad to EEPROM
+	static const uint16_t MaxBusy = 1000; // ms of a conversion or copy polled, 750 by spec
 
+	// Read Power Supply to all devices, reset is done here
+	static bool detectPower()
+	{
+		if (!Wire::reset())
+			return false;
+		Wire::skip();
+		Wire::write(0xB4);
+		// parasite powered devices pull the slot low
+		parasite = parasitePower || !Wire::ioBit();
+		return true;
+	}
+	static bool isParasite()
+	{
+		return parasite;
+	}
+	// parasite powered devices can not be converted one by one,
+	// the bus is held high until all of them are done
 	static void convert()
 	{
-		Wire::write(0x44);
+		if (seen)
+			resolution = seen;
+		seen = 0;
+		Wire::write(0x44, parasite);
+	}
+	// ms by resolution, 93.75 ms at 9 bit up to 750 ms at 12 bit
+	static uint16_t conversionTime()
+	{
+		uint8_t shift = 12 - resolution;
+		return (750 + (1 << shift) - 1) >> shift;
+	}
+	// sleep is used while strong pull-up is on, busy wait if none;
+	// false if the devices are still busy after MaxBusy
+	static bool wait(Sleep sleep = 0)
+	{
+		if (parasite)
+		{
+			hold(conversionTime(), sleep);
+			return true;
+		}
+		return poll();
+	}
+	// ends strong pull-up of a conversion waited for by the caller
+	static void release()
+	{
+		Wire::strongPullUp(false);
 	}
-	static void wait()
+	// scratchpad TH, TL and configuration to EEPROM of selected devices,
+	// false as of wait()
+	static bool copy(Sleep sleep = 0)
 	{
-		if (parasitePower)
+		Wire::write(0x48, parasite);
+		if (parasite)
 		{
-			_delay_ms(750);
-		} else {
-			while (!Wire::ioBit()) ;
+			hold(CopyTime, sleep);
+			return true;
 		}
+		return poll();
 	}
 	template <bool ds18s20>
 	static Temperature read()
@@ -286,17 +537,72 @@ public:
 	}
 	template <int retryCount = 5>
 	static Temperature read(const Addr& addr) {
-		for (int i = 0; i < retryCount; ++i) {
-			if (!Wire::reset())
+		DeviceStats stats = DeviceStats();
+		return read<retryCount>(addr, stats);
+	}
+	// failures and retries are added to stats, see ReadMode
+	template <int retryCount = 5>
+	static Temperature read(const Addr& addr, DeviceStats& stats, ReadMode mode = ReadFull) {
+		for (uint8_t i = 0; i < retryCount; ++i) {
+			if (!Wire::reset()) {
+				saturatingInc(stats.resetFails);
 				continue;
+			}
 			Wire::select(addr);
-			Temperature t = readRaw().toTemperature(addr[0] == 0x10);
-			if (t.isValid())
+			Temperature t = readOnce(addr, stats, mode);
+			if (t.isValid()) {
+				saturatingInc(stats.retries, i);
+				stats.last = t.get();
+				stats.known = true;
 				return t;
+			}
+			saturatingInc(stats.crcErrors);
 		}
+		saturatingInc(stats.fails);
 		return Temperature();
 	}
+
+	static const int16_t MinValue = (-55_C).get();
+	static const int16_t MaxValue = (125_C).get();
+	static const int16_t MaxStep = (8_K).get();
+	static const uint8_t FullEvery = 16;
+	static ReadStats readStats;
 private:
+	// device is selected
+	static Temperature readOnce(const Addr& addr, DeviceStats& stats, ReadMode mode)
+	{
+		bool ds18s20 = addr[0] == 0x10;
+		bool full = mode == ReadFull
+				|| (mode == ReadAdaptive && (!stats.known || stats.sinceFull >= FullEvery));
+		if (!full) {
+			saturatingInc(readStats.shortReads);
+			Temperature t = readShort().toTemperature(ds18s20);
+			if (isPlausible(t, stats)) {
+				++stats.sinceFull;
+				return t;
+			}
+			saturatingInc(readStats.implausible);
+			if (mode != ReadAdaptive || !Wire::reset())
+				return Temperature();
+			saturatingInc(readStats.upgrades);
+			Wire::select(addr);
+		}
+		stats.sinceFull = 0;
+		saturatingInc(readStats.full);
+		Temperature t = readRaw().toTemperature(ds18s20);
+		if (!t.isValid())
+			saturatingInc(readStats.crcErrors);
+		return t;
+	}
+	static bool isPlausible(Temperature t, const DeviceStats& stats)
+	{
+		if (!t.isValid() || t.get() < MinValue || t.get() > MaxValue)
+			return false;
+		if (!stats.known)
+			return t.get() != (85_C).get(); // power-on value
+		int16_t d = t.get() - stats.last;
+		return d <= MaxStep && d >= -MaxStep;
+	}
 	struct RawTemperature {
 		uint8_t h,l;
 		Temperature toTemperature(bool ds18s20) const {
@@ -308,6 +614,14 @@ private:
 			return Temperature(h, l);
 		}
 	};
+	// temperature bytes, the rest is dropped by the next reset
+	static RawTemperature readShort() {
+		Wire::write(0xbe);
+		uint8_t templ = Wire::read();
+		uint8_t temph = Wire::read();
+		return {temph, templ};
+	}
+
 	static RawTemperature readRaw() {
 		Wire::write(0xbe);
 
@@ -327,9 +641,49 @@ private:
 		if (Wire::read() != crc)
 			return {255, 255};
 
+		// R1:R0 of DS18B20, reserved 0xFF of DS18S20 gives 12 bit
+		uint8_t bits = 9 + ((conf >> 5) & 3);
+		if (bits > seen)
+			seen = bits;
 		return {temph, templ};
 	}
+	// read slots until devices are done, a device stuck low is a timeout
+	static bool poll()
+	{
+		Clock::clock_t deadline = Clock::millis() + MaxBusy;
+		while (!Wire::ioBit())
+		{
+			if (int32_t(Clock::millis() - deadline) >= 0)
+			{
+				saturatingInc(Wire::stats.timeouts);
+				return false;
+			}
+		}
+		return true;
+	}
+	static void hold(uint16_t ms, Sleep sleep)
+	{
+		if (sleep)
+			sleep(ms);
+		else
+			while (ms--)
+				_delay_ms(1);
+		Wire::strongPullUp(false);
+	}
+
+	static bool parasite;
+	static uint8_t resolution; // bits of conversionTime()
+	static uint8_t seen;       // highest of devices read since convert()
 };
 
+template <class Wire, bool parasitePower>
+bool DS1820<Wire, parasitePower>::parasite = parasitePower;
+template <class Wire, bool parasitePower>
+uint8_t DS1820<Wire, parasitePower>::resolution = 12;
+template <class Wire, bool parasitePower>
+uint8_t DS1820<Wire, parasitePower>::seen = 0;
+template <class Wire, bool parasitePower>
+ReadStats DS1820<Wire, parasitePower>::readStats;
+
 } // namespace OneWire
 #endif
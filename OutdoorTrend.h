@@ -0,0 +1,86 @@
+#ifndef OUTDOORTREND_H_
+#define OUTDOORTREND_H_
+
+#include <inttypes.h>
+
+#include "Clock.h"
+#include "temperature.h"
+
+/**
+ * History of outdoor temperature, an average of each Interval, the last
+ * Size of them. Trend is the least squares slope of the history, so
+ * a house heated by HeatingCurve(outdoor + trend * lead) follows the
+ * weather ahead of the indoor error. Constant RAM, 32 bit math once
+ * per Interval and per trend(). Averages must be Interval apart, so
+ * samples more than MaxGap apart, e.g. of a sensor that was stale,
+ * start the history again.
+ *
+ * Example
+ *
+ * 		history.put(outdoor, now);
+ * 		Temperature ahead = history.predict(Temperature(outdoor), 60);
+ */
+class OutdoorTrend {
+public:
+	static const uint8_t Size = 12;
+	static const uint16_t Interval = 900; // s, 3 hours of history
+	static const uint8_t MinCount = 3;    // intervals for a trend
+	static const uint16_t MaxGap = Interval / 3; // s between samples
+	static const int16_t MaxAhead = (10_K).get();
+
+	OutdoorTrend() : head(0), count(0), sum(0), samples(0), start(0), previous(0) {}
+
+	void put(int16_t t, Clock::clock_t now) {
+		if (now - previous > uint32_t(MaxGap) * 1000) {
+			count = 0;
+			sum = 0;
+			samples = 0;
+		}
+		previous = now;
+		if (samples == 0)
+			start = now;
+		sum += t;
+		++samples;
+		if (now - start >= uint32_t(Interval) * 1000) {
+			head = (head + 1) % Size;
+			history[head] = sum / samples;
+			if (count < Size)
+				++count;
+			sum = 0;
+			samples = 0;
+		}
+	}
+	bool isKnown() const { return count >= MinCount; }
+	// the last average, t if there is none
+	int16_t last(int16_t t) const { return count ? history[head] : t; }
+	// 1/16 degree per hour, 0 if not known
+	int16_t trend() const {
+		if (!isKnown())
+			return 0;
+		// sum of (2i - (n - 1)) * y over oldest i = 0 to newest
+		int32_t num = 0;
+		uint8_t n = count;
+		for (uint8_t i = 0; i < n; ++i) {
+			uint8_t k = (head + Size - (n - 1 - i)) % Size;
+			num += int32_t(2 * i - (n - 1)) * history[k];
+		}
+		int32_t den = int32_t(n) * (n * n - 1) / 6;
+		return Fixed::saturate(num * (3600 / Interval) / den);
+	}
+	// outdoor expected after lead minutes, up to MaxAhead from now
+	Temperature predict(Temperature outdoor, uint8_t lead) const {
+		int32_t d = int32_t(trend()) * lead / 60;
+		d = d > MaxAhead ? MaxAhead : d < -MaxAhead ? -MaxAhead : d;
+		return outdoor + TemperatureDelta(d);
+	}
+private:
+	int16_t history[Size];
+	uint8_t head;  // the newest
+	uint8_t count;
+	int32_t sum;   // of the current interval
+	uint16_t samples;
+	Clock::clock_t start;
+	Clock::clock_t previous; // of the last sample
+};
+
+#endif /* OUTDOORTREND_H_ */
@@ -0,0 +1,143 @@
+#include <stddef.h>
+#include <avr/pgmspace.h>
+
+#include "Params.h"
+#include "Cascade.h"
+#include "Eeprom.h"
+#include "Log.h"
+
+#define PARAM(name, type, field, min, max) \
+	{ name, Params::type, offsetof(Settings, field), min, max }
+
+static const Params::Entry table[] PROGMEM = {
+	PARAM("cycle",     U16,  cycleTime,        1000, 30000),
+	PARAM("bDelay",    U16,  boilerDelay,      0,    3600),
+	PARAM("bDelayOff", U16,  boilerDelayOff,   0,    3600),
+	PARAM("bRetry",    U16,  boilerRetryDelay, 0,    3600),
+	PARAM("rShift",    Temp, radiatorShift,    (-15_K).get(), (15_K).get()),
+	PARAM("rRoomK",    I16,  radiatorRoomK,    0,    16),
+	PARAM("indoor",    Temp, indoorTarget,     (10_C).get(), (30_C).get()),
+	PARAM("rP",        U8,   radiatorP,        0,    255),
+	PARAM("rI",        U8,   radiatorI,        0,    255),
+	PARAM("rD",        U8,   radiatorD,        0,    255),
+	PARAM("bMaxDelta", Temp, boilerMaxDelta,   (4_K).get(), (60_K).get()),
+	PARAM("bP",        U8,   boilerP,          0,    255),
+	PARAM("bI",        U8,   boilerI,          0,    255),
+	PARAM("bD",        U8,   boilerD,          0,    255),
+	PARAM("mbAddr",    U8,   modbusAddr,       0,    247),
+	PARAM("log",       U8,   logMask,          0,    Log::All),
+	PARAM("rLead",     U8,   radiatorLead,     0,    240),
+	PARAM("owRead",    U8,   readMode,         0,    OneWire::ReadModeCount - 1),
+};
+
+static const Settings defaultSettings = {
+	2500, // 2.5 sec per loop, fastest cascade period
+	600,  // 10 minute
+	900,  // 15 minute
+	900,  // 15 minute
+	RadiatorDefaults::Shift,
+	RadiatorDefaults::RoomK,
+	RadiatorDefaults::IndoorTarget,
+	2, 0, 65,
+	BoilerDefaults::MaxDelta,
+	4, 0, 65,
+	0,    // no Modbus
+	Log::All,
+	RadiatorDefaults::Lead,
+	OneWire::ReadAdaptive
+};
+
+const uint8_t Params::Count = sizeof(table) / sizeof(table[0]);
+Settings Params::active;
+Settings Params::pending;
+bool Params::dirty = false;
+
+// bumped on any change of layout or meaning of Settings
+const uint8_t SettingsVersion = 6;
+typedef EepromRing<Settings, EepromLayout::Params, 2, SettingsVersion> ParamsRing;
+static_assert(EepromLayout::Params + ParamsRing::Size <= EepromLayout::Curve,
+		"params do not fit EEPROM");
+static ParamsRing ring;
+
+// value of entry e in s
+static int16_t field(const Settings& s, const Params::Entry& e) {
+	const uint8_t* p = reinterpret_cast<const uint8_t*>(&s) + e.offset;
+	if (e.type == Params::U8)
+		return *p;
+	return *reinterpret_cast<const int16_t*>(p);
+}
+
+static void setField(Settings& s, const Params::Entry& e, int16_t value) {
+	uint8_t* p = reinterpret_cast<uint8_t*>(&s) + e.offset;
+	if (e.type == Params::U8)
+		*p = value;
+	else
+		*reinterpret_cast<int16_t*>(p) = value;
+}
+
+void Params::init() {
+	if (!ring.load(pending))
+		pending = defaultSettings;
+	// stored values may come from older table, out of range ones are default
+	for (uint8_t i = 0; i < Count; ++i)
+		if (!set(i, get(i)))
+			set(i, field(defaultSettings, entry(i)));
+	active = pending;
+	dirty = false;
+}
+
+int8_t Params::find(const char* name) {
+	for (uint8_t i = 0; i < Count; ++i)
+		if (strcmp_P(name, table[i].name) == 0)
+			return i;
+	return -1;
+}
+
+Params::Entry Params::entry(uint8_t i) {
+	Entry e;
+	memcpy_P(&e, &table[i], sizeof(e));
+	return e;
+}
+
+int16_t Params::get(uint8_t i) {
+	return field(pending, entry(i));
+}
+
+bool Params::set(uint8_t i, int16_t value) {
+	Entry e = entry(i);
+	if (value < e.min || value > e.max)
+		return false;
+	setField(pending, e, value);
+	dirty = true;
+	return true;
+}
+
+bool Params::apply() {
+	if (!dirty)
+		return false;
+	active = pending;
+	dirty = false;
+	return true;
+}
+
+void Params::save() {
+	ring.save(pending);
+}
+
+bool Params::store(uint8_t n, const uint8_t* entries, const int16_t* values) {
+	Settings stored;
+	if (!ring.load(stored))
+		stored = defaultSettings;
+	for (uint8_t k = 0; k < n; ++k) {
+		if (!set(entries[k], values[k]))
+			return false;
+		setField(stored, entry(entries[k]), values[k]);
+	}
+	ring.save(stored);
+	return true;
+}
+
+void Params::defaults() {
+	pending = defaultSettings;
+	dirty = true;
+}
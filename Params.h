@@ -0,0 +1,72 @@
+#ifndef PARAMS_H_
+#define PARAMS_H_
+
+#include <inttypes.h>
+
+// Tuning values changeable at runtime, see Params
+struct Settings {
+	uint16_t cycleTime;        // ms per loop
+	uint16_t boilerDelay;      // s before burner is switched on
+	uint16_t boilerDelayOff;   // s before burner is switched off
+	uint16_t boilerRetryDelay; // s of cold thermocouple before restart
+	int16_t radiatorShift;     // parallel shift of HeatingCurve
+	int16_t radiatorRoomK;     // feed degrees per degree of indoor error
+	int16_t indoorTarget;
+	uint8_t radiatorP;
+	uint8_t radiatorI;
+	uint8_t radiatorD;
+	int16_t boilerMaxDelta;
+	uint8_t boilerP;
+	uint8_t boilerI;
+	uint8_t boilerD;
+	uint8_t modbusAddr;        // 1..247, 0 is text log and console
+	uint8_t logMask;           // bit of each Log::Channel
+	uint8_t radiatorLead;      // minutes of outdoor trend ahead of HeatingCurve
+	uint8_t readMode;          // OneWire::ReadMode of DS18x20 scratchpad
+};
+
+/**
+ * Typed parameter table over Settings, stored in EEPROM.
+ * set() changes pending values only, control loops see them
+ * after apply() at the next cycle boundary.
+ */
+class Params {
+public:
+	enum Type : uint8_t {
+		U8,
+		U16,
+		I16,
+		Temp // int16_t in 1/16 degree
+	};
+	struct Entry {
+		char name[10];
+		Type type;
+		uint8_t offset;
+		int16_t min;
+		int16_t max;
+	};
+
+	static const uint8_t Count;
+	static Settings active;
+
+	// load from EEPROM, defaults if nothing valid stored
+	static void init();
+	// returns -1 if not found
+	static int8_t find(const char* name);
+	static Entry entry(uint8_t i);
+	static int16_t get(uint8_t i);
+	// returns false if value is out of range
+	static bool set(uint8_t i, int16_t value);
+	// returns true if active values were changed
+	static bool apply();
+	static void save();
+	// sets n entries and saves only them over the stored values,
+	// other pending values stay unsaved; false if any is out of range
+	static bool store(uint8_t n, const uint8_t* entries, const int16_t* values);
+	static void defaults();
+private:
+	static Settings pending;
+	static bool dirty;
+};
+
+#endif /* PARAMS_H_ */
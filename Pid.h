@@ -0,0 +1,71 @@
+#ifndef PID_H_
+#define PID_H_
+
+#include <inttypes.h>
+
+namespace Pid {
+
+inline int32_t clamp(int32_t v, int32_t lo, int32_t hi) {
+	return v < lo ? lo : v > hi ? hi : v;
+}
+
+/**
+ * PID terms with 32 bit accumulators.
+ * Integral is kept in fixed point with Q fraction bits, so small i*err
+ * are not lost. It is not integrated further while the command is
+ * saturated in the same direction (conditional integration).
+ * Derivative is taken from measurement, change of target gives no kick.
+ * Gains are tuned for step period ref; dt scales i and d terms.
+ */
+template <int16_t Max, int16_t Min, uint8_t Q = 8>
+class Core {
+public:
+	static const int32_t IntegralMax = int32_t(Max / 25) * (1L << Q);
+	static const int32_t IntegralMin = int32_t(Min / 25) * (1L << Q);
+
+	Core() : integral(0), previous(0), dValue(0), pValue(0), output(0), first(true) {}
+
+	// err is measurement - target, dt and ref are ms
+	int16_t step(int16_t err, int16_t measurement, uint16_t dt, uint16_t ref,
+			uint8_t p, uint8_t i, uint8_t d) {
+		if (first) {
+			previous = measurement;
+			first = false;
+		}
+		// ref / dt with 4 fraction bits, at most 8, so d * change * ratio
+		// fits 32 bit for any change of a 16 bit measurement
+		int32_t ratio = clamp((uint32_t(ref) << 4) / dt, 0, 8 << 4);
+		int32_t dv = (3L * dValue + int32_t(d) * (int32_t(measurement) - previous) * ratio / 16) / 4;
+		previous = measurement;
+		dValue = clamp(dv, Min, Max);
+		if (dValue > Max / 2)
+			return output = Max;
+		if (dValue < Min / 2)
+			return output = Min;
+
+		pValue = clamp(int32_t(err) * p, Min, Max);
+		// (dt << Q) / ref is at most 8 << Q, product fits 32 bit for |err| < 1024
+		int32_t di = int32_t(i) * err * int32_t((uint32_t(dt) << Q) / ref) / 16;
+		int32_t u = int32_t(pValue) + (integral >> Q) + dValue;
+		if (!((u >= Max && di > 0) || (u <= Min && di < 0)))
+			integral = clamp(integral + di, IntegralMin, IntegralMax);
+
+		// halfway to the command, the last step of 1 is not lost to rounding
+		int32_t diff = int32_t(pValue) + (integral >> Q) + dValue - output;
+		output = clamp(output + (diff + (diff > 0) - (diff < 0)) / 2, Min, Max);
+		return output;
+	}
+	void saturate(int16_t v) { output = v; }
+	void reset() { output = 0; integral = 0; previous = 0; }
+
+	int32_t integral; // Q fraction bits
+	int16_t previous; // measurement of previous step
+	int16_t dValue;
+	int16_t pValue;
+	int16_t output;
+	bool first;
+};
+
+} // namespace Pid
+
+#endif /* PID_H_ */
@@ -0,0 +1,177 @@
+#ifndef PLANT_H_
+#define PLANT_H_
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "Clock.h"
+#include "Cascade.h"
+#include "Params.h"
+#include "Snapshot.h"
+#include "Autotune.h"
+#include "Stats.h"
+#include "Log.h"
+#include "serial.h"
+
+template <class Z>
+struct ZoneTag {};
+
+/**
+ * All zones of the plant, each one is a cascade member, no virtuals.
+ * Operations run over the zones by recursion at compile time, code and
+ * RAM grow with number of zones only. Zones are numbered in the order
+ * of the list from 0, zone number i is a bit in masks.
+ *
+ * Example
+ *
+ * 		typedef Plant<RadiatorCascade<Floor>, BoilerCascade<Boiler> > Zones;
+ *
+ * 		uint8_t stepped = zones.step(frame, now, com);
+ * 		zones.get<BoilerCascade<Boiler> >().getOutput();
+ */
+// zones from number First on
+template <uint8_t First, class... Zones>
+class ZoneList;
+
+template <class... Zones>
+using Plant = ZoneList<0, Zones...>;
+
+template <uint8_t First>
+class ZoneList<First> {
+public:
+	static const uint8_t Count = 0;
+	struct State {};
+
+	static int8_t find(const char*) { return -1; }
+	void configure() {}
+	template <class S>
+	uint8_t step(const Sensors::Frame&, Clock::clock_t, S&) { return 0; }
+	void tune(uint8_t, Clock::clock_t) {}
+	template <class S>
+	void storeTuning(S&) {}
+	template <class S>
+	void log(S&) const {}
+	void save(State&) const {}
+	void restore(const State&) {}
+	void registers(int16_t*) const {}
+	void countTravel(uint8_t) {}
+	void startRuns(uint8_t, Clock::clock_t) {}
+	bool stopRuns(Clock::clock_t) { return false; }
+	Clock::clock_t nextStop(Clock::clock_t deadline) const { return deadline; }
+protected:
+	void zone(ZoneTag<void>) {}
+};
+
+template <uint8_t First, class Z, class... Rest>
+class ZoneList<First, Z, Rest...>: public ZoneList<First + 1, Rest...> {
+	typedef ZoneList<First + 1, Rest...> parent_t;
+public:
+	static const uint8_t Index = First;
+	static const uint8_t Count = sizeof...(Rest) + 1; // of this and the following zones
+	struct State: parent_t::State {
+		typename Z::State zone;
+	};
+	static_assert(First + Count <= 8, "zone masks are 8 bit");
+
+	template <class T>
+	T& get() { return zone(ZoneTag<T>()); }
+
+	// zone index by name, -1 if not found
+	static int8_t find(const char* name) {
+		return strcmp(name, Z::zone_t::name()) == 0 ? Index : parent_t::find(name);
+	}
+	// reload gains after Params::apply()
+	void configure() {
+		head.configure();
+		parent_t::configure();
+	}
+	// steps due zones, returns mask of stepped ones
+	template <class S>
+	uint8_t step(const Sensors::Frame& frame, Clock::clock_t now, S& com) {
+		uint8_t stepped = 0;
+		if (head.isDue(now)) {
+			stepped = 1 << Index;
+			if (!head.step(frame, now))
+				LOG(com, Z::zone_t::LogChannel, Log::Error) << Z::zone_t::name() << " cascade fail" << endl;
+		}
+		return stepped | parent_t::step(frame, now, com);
+	}
+	// takes Autotune::request
+	void tune(uint8_t request, Clock::clock_t now) {
+		if (request == Autotune::StopTuning)
+			head.stopTune();
+		else if (request == Autotune::TuneZone + Index)
+			head.startTune(now);
+		parent_t::tune(request, now);
+	}
+	// store gains of finished autotune
+	template <class S>
+	void storeTuning(S& com) {
+		Autotune::Status status = head.tuneStatus();
+		if (status == Autotune::Done) {
+			Autotune::Result r = head.tuneResult(Autotune::TyreusLuyben);
+			// other pending edits are not saved with the gains
+			uint8_t entries[3];
+			for (uint8_t k = 0; k < 3; ++k)
+				entries[k] = Params::find(Z::zone_t::gainParam(k));
+			const int16_t gains[3] = { r.p, r.i, r.d };
+			Params::store(3, entries, gains);
+			LOG(com, Z::zone_t::LogChannel, Log::Info) << Z::zone_t::name() << " tuned p="
+					<< int(r.p) << " i=" << int(r.i) << " d=" << int(r.d) << endl;
+		} else if (status == Autotune::Failed) {
+			LOG(com, Z::zone_t::LogChannel, Log::Error) << Z::zone_t::name() << " tune failed" << endl;
+		}
+		if (status == Autotune::Done || status == Autotune::Failed)
+			head.stopTune();
+		parent_t::storeTuning(com);
+	}
+	template <class S>
+	void log(S& s) const {
+		LOG(s, Z::zone_t::LogChannel, Log::Info) << Z::zone_t::name() << ' ' << head << endl;
+		parent_t::log(s);
+	}
+	void save(State& s) const {
+		head.save(s.zone);
+		parent_t::save(s);
+	}
+	void restore(const State& s) {
+		head.restore(s.zone);
+		parent_t::restore(s);
+	}
+	// CascadeRegister::Count values per zone, zone 0 first
+	void registers(int16_t* r) const {
+		head.registers(r + Index * CascadeRegister::Count);
+		parent_t::registers(r);
+	}
+	// valve drive of stepped zones to Stats
+	void countTravel(uint8_t stepped) {
+		if (stepped & (1 << Index))
+			Stats::addTime(Stats::Counter(Stats::Valve + Index), head.getAbsOutput());
+		parent_t::countTravel(stepped);
+	}
+	// valves of stepped zones start to run at now, outputs are written already
+	void startRuns(uint8_t stepped, Clock::clock_t now) {
+		if (stepped & (1 << Index))
+			head.startRun(now);
+		parent_t::startRuns(stepped, now);
+	}
+	// stops valves whose drive time is over, true if any outputs changed
+	bool stopRuns(Clock::clock_t now) {
+		bool stopped = head.stopRun(now);
+		return parent_t::stopRuns(now) || stopped;
+	}
+	// the earliest end of a valve run before deadline, deadline if none
+	Clock::clock_t nextStop(Clock::clock_t deadline) const {
+		Clock::clock_t t = parent_t::nextStop(deadline);
+		if (head.isRunning() && int32_t(head.getRunEnd() - t) < 0)
+			t = head.getRunEnd();
+		return t;
+	}
+protected:
+	using parent_t::zone;
+	Z& zone(ZoneTag<Z>) { return head; }
+private:
+	Z head;
+};
+
+#endif /* PLANT_H_ */
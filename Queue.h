@@ -0,0 +1,150 @@
+#ifndef QUEUE_H_
+#define QUEUE_H_
+
+#include <inttypes.h>
+
+#ifndef __AVR__
+#include <atomic>
+#endif
+
+/**
+ * Hand off between one producer and one consumer, one of them may be an ISR.
+ * Each side writes only its own 8 bit counter, so nothing is locked:
+ * a byte store is atomic on AVR, on host std::atomic orders the data.
+ */
+namespace Lockfree {
+
+#ifdef __AVR__
+// volatile byte, compiler barrier keeps data accesses on their side of it
+class Counter {
+public:
+	Counter() : v(0) {}
+	uint8_t load() const {
+		uint8_t x = v;
+		__asm__ __volatile__ ("" ::: "memory");
+		return x;
+	}
+	void store(uint8_t x) {
+		__asm__ __volatile__ ("" ::: "memory");
+		v = x;
+	}
+private:
+	volatile uint8_t v;
+};
+#else
+class Counter {
+public:
+	Counter() : v(0) {}
+	uint8_t load() const { return v.load(std::memory_order_acquire); }
+	void store(uint8_t x) { v.store(x, std::memory_order_release); }
+private:
+	std::atomic<uint8_t> v;
+};
+#endif
+
+/**
+ * Ring buffer, counters run freely and wrap at 256.
+ *
+ * Example
+ *
+ * 		ISR:  queue.push(UDR0);
+ * 		main: while (queue.pop(c)) ...
+ */
+template <class T, uint8_t Size>
+class Queue {
+	static_assert(Size > 0 && Size <= 128 && (Size & (Size - 1)) == 0,
+			"size is a power of 2 up to 128");
+public:
+	// producer only, returns false if full
+	bool push(const T& x) {
+		uint8_t h = head.load();
+		if (uint8_t(h - tail.load()) == Size)
+			return false;
+		buf[h & (Size - 1)] = x;
+		head.store(h + 1);
+		return true;
+	}
+	// consumer only, returns false if empty
+	bool pop(T& x) {
+		uint8_t t = tail.load();
+		if (t == head.load())
+			return false;
+		x = buf[t & (Size - 1)];
+		tail.store(t + 1);
+		return true;
+	}
+	// consumer only, element stays in queue
+	bool peek(T& x) const {
+		uint8_t t = tail.load();
+		if (t == head.load())
+			return false;
+		x = buf[t & (Size - 1)];
+		return true;
+	}
+	// exact on either side, a bound for the other one
+	uint8_t count() const { return head.load() - tail.load(); }
+	bool isEmpty() const { return count() == 0; }
+private:
+	T buf[Size];
+	Counter head; // written by producer
+	Counter tail; // written by consumer
+};
+
+/**
+ * Event posted by producer, taken by consumer, none of them is lost
+ * until 255 are pending.
+ */
+class Event {
+public:
+	void post() {
+		posted.store(posted.load() + 1);
+	}
+	// number of events since previous take, consumer only
+	uint8_t take() {
+		uint8_t p = posted.load();
+		uint8_t n = p - taken.load();
+		taken.store(p);
+		return n;
+	}
+	bool isPending() const { return posted.load() != taken.load(); }
+private:
+	Counter posted;
+	Counter taken;
+};
+
+/**
+ * Value written by one side, usually an ISR, and read by the other one.
+ * Wider than a byte, so reader repeats until two reads agree; writer
+ * must not be interrupted by reader.
+ */
+#ifdef __AVR__
+template <class T>
+class Shared {
+public:
+	Shared() : v() {}
+	T get() const {
+		T x;
+		do {
+			x = v;
+		} while (x != v);
+		return x;
+	}
+	void set(T x) { v = x; }
+private:
+	volatile T v;
+};
+#else
+template <class T>
+class Shared {
+public:
+	Shared() : v(T()) {}
+	T get() const { return v.load(std::memory_order_acquire); }
+	void set(T x) { v.store(x, std::memory_order_release); }
+private:
+	std::atomic<T> v;
+};
+#endif
+
+} // namespace Lockfree
+
+#endif /* QUEUE_H_ */
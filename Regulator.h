@@ -8,53 +8,73 @@
 #ifndef REGULATOR_H_
 #define REGULATOR_H_
 
+#include "Pid.h"
+
 typedef int16_t output_t;
 template <typename InputType = int16_t, output_t Max = 40000, output_t Min = -40000, InputType Large = 1000>
 class Regul {
 public:
 	typedef InputType input_t;
+	// ms, i and d gains are tuned for steps with this period
+	static const uint16_t ReferencePeriod = 5000;
+	static const uint8_t Q = 8; // fraction bits of integral
+	struct State {
+		input_t previos;
+		int32_t integral;
+		output_t dValue;
+		output_t output;
+	};
 
 	Regul(input_t target, uint8_t p = 2, uint8_t i = 0, uint8_t d = 65)
-		: target(target), p(p), i(i), d(d),
-		  previos(0), integral(0), dValue(0), output(0), isFirstCircle(true) {}
-	output_t step(input_t current) {
-		input_t err = current - target;
-		if (err > Large)
-			return output=Max;
-		if (err < -Large)
-			return output=Min;
-		integral += (i * err)/16;
-		integral = limit<25>(integral);
-
-		if (isFirstCircle) {
-			previos = err;
-			isFirstCircle = false;
+		: target(target), p(p), i(i), d(d) {}
+	// dt is ms elapsed since previous step
+	output_t step(input_t current, uint16_t dt = ReferencePeriod) {
+		if (dt < ReferencePeriod / 8)
+			dt = ReferencePeriod / 8;
+		if (dt > ReferencePeriod * 8)
+			dt = ReferencePeriod * 8;
+		int32_t err = int32_t(current) - target;
+		if (err > Large) {
+			core.saturate(Max);
+			return Max;
 		}
-		dValue = (3*dValue + d*(err - previos)) / 4;
-		previos = err;
-
-		if (dValue > Max / 2)
-			return output=Max;
-		if (dValue < Min / 2)
-			return output=Min;
-
-		output_t cur = err * p + integral + dValue; // TODO check overflow
-		output = (output + cur) / 2;
-		output = limit(output);
-		return output;
+		if (err < -Large) {
+			core.saturate(Min);
+			return Min;
+		}
+		return core.step(err, current, dt, ReferencePeriod, p, i, d);
 	}
 	void setTarget(input_t t) {
 		target = t;
 	}
-	void reset() { output = 0; integral = 0; previos = 0; }
+	void setGains(uint8_t newP, uint8_t newI, uint8_t newD) {
+		p = newP;
+		i = newI;
+		d = newD;
+	}
+	void reset() { core.reset(); }
+	// output set outside of regulator, e.g. by autotune
+	void force(output_t v) { core.saturate(limit(v)); }
+	State save() const { return { core.previous, core.integral, core.dValue, core.output }; }
+	void restore(const State& s) {
+		core.previous = s.previos;
+		core.integral = Pid::clamp(s.integral, core_t::IntegralMin, core_t::IntegralMax);
+		core.dValue = limit(s.dValue);
+		core.output = limit(s.output);
+		core.first = false;
+	}
 	input_t getTarget() const { return target; }
-	output_t getOutput() const { return output; }
+	output_t getOutput() const { return core.output; }
+	// terms of the last step
+	output_t getP() const { return core.pValue; }
+	output_t getI() const { return core.integral >> Q; }
+	output_t getD() const { return core.dValue; }
 	template <class S>
 	S& log(S& s) const {
 		s << "Target: " << getTarget() << ", Output: " << getOutput()
-				<< ", p: " << previos * p
-				<< ", i: " << integral
-				<< ", d: " << dValue;
+				<< ", p: " << core.pValue
+				<< ", i: " << getI()
+				<< ", d: " << core.dValue;
 		return s;
 	}
 	template <uint8_t div =1>
@@ -67,15 +87,12 @@ public:
 	}
 
 private:
+	typedef Pid::Core<Max, Min, Q> core_t;
 	input_t target;
 	uint8_t p;
 	uint8_t i;
 	uint8_t d;
-	input_t previos;
-	output_t integral;
-	output_t dValue;
-	output_t output;
-	bool isFirstCircle;
+	core_t core;
 };
 
 
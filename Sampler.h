@@ -0,0 +1,86 @@
+#ifndef SAMPLER_H_
+#define SAMPLER_H_
+
+#include <inttypes.h>
+
+#include "Clock.h"
+#include "Sensors.h"
+#include "temperature.h"
+
+/**
+ * Per role sampling scheduler.
+ * Read period of a role starts at minimum of its class, is halved when
+ * temperature changes fast and doubled when it stays still.
+ *
+ * Example
+ *
+ * 		if (sampler.due(role, now)) {
+ * 			...
+ * 			sampler.update(role, t.get(), now);
+ * 		}
+ */
+class Sampler {
+public:
+	typedef Sensors::Role Role;
+	static const int16_t FastRate = (0.5_K).get(); // per period
+	static const int16_t SlowRate = 1;
+
+	Sampler() {
+		for (uint8_t i = 0; i < Sensors::RoleCount; ++i) {
+			slot[i].next = 0;
+			slot[i].period = minPeriod(Role(i));
+			slot[i].value = Temperature::Error;
+			slot[i].valid = false;
+		}
+	}
+	bool due(Role r, Clock::clock_t now) const {
+		return int32_t(now - slot[r].next) >= 0;
+	}
+	// successful read at now; failed read is retried on the next due()
+	void update(Role r, int16_t value, Clock::clock_t now) {
+		Slot& s = slot[r];
+		if (s.valid) {
+			int16_t delta = value - s.value;
+			if (delta < 0)
+				delta = -delta;
+			if (delta >= FastRate)
+				s.period /= 2;
+			else if (delta <= SlowRate)
+				s.period *= 2;
+			if (s.period < minPeriod(r))
+				s.period = minPeriod(r);
+			if (s.period > maxPeriod(r))
+				s.period = maxPeriod(r);
+		}
+		s.value = value;
+		s.valid = true;
+		s.next = now + Clock::clock_t(s.period) * 1000;
+	}
+	uint16_t period(Role r) const { return slot[r].period; }
+
+	// limits of read period in seconds
+	static uint16_t minPeriod(Role r) {
+		switch (Sensors::classOf(r)) {
+		case Sensors::Fast: return 2;
+		case Sensors::Medium: return 5;
+		default: return 30;
+		}
+	}
+	static uint16_t maxPeriod(Role r) {
+		switch (Sensors::classOf(r)) {
+		case Sensors::Fast: return 15;
+		case Sensors::Medium: return 30;
+		default: return 300;
+		}
+	}
+private:
+	struct Slot {
+		Clock::clock_t next;
+		uint16_t period; // s
+		int16_t value;
+		bool valid;
+	};
+	Slot slot[Sensors::RoleCount];
+};
+
+#endif /* SAMPLER_H_ */
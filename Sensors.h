@@ -0,0 +1,92 @@
+#ifndef SENSORS_H_
+#define SENSORS_H_
+
+#include <inttypes.h>
+
+#include "OneWire.h"
+
+namespace Sensors {
+
+typedef OneWire::ConstAddr<0x28, 0xD9, 0xF8, 0xD5, 0x03, 0x00, 0x00, 0xB0> RadiatorAddr;
+typedef OneWire::ConstAddr<0x28, 0x0A, 0xFB, 0xD5, 0x03, 0x00, 0x00, 0x63> OutdoorAddr;
+typedef OneWire::ConstAddr<0x28, 0xC3, 0xE0, 0xD5, 0x03, 0x00, 0x00, 0x66> IndoorAddr;
+typedef OneWire::ConstAddr<0x28, 0x8D, 0x2E, 0x8E, 0x05, 0x00, 0x00, 0x1D> BoilerOutAddr;
+typedef OneWire::ConstAddr<0x28, 0x50, 0x05, 0xD6, 0x03, 0x00, 0x00, 0x0E> BoilerInAddr;
+typedef OneWire::ConstAddr<0x10, 0xA1, 0x7B, 0x0F, 0x02, 0x08, 0x00, 0x2E> HeatOutputAddr;
+
+const uint8_t OtherCount = 4; // unknown devices with a role of their own
+
+enum Role : uint8_t {
+	Radiator,
+	Indoor,
+	Outdoor,
+	BoilerIn,
+	BoilerOut,
+	HeatOutput,
+	Thermocouple, // max6675 in firebox, not on 1-Wire bus
+	Flue,         // max6675 in flue
+	Other,        // first of OtherCount unknown devices found by search
+	RoleCount = Other + OtherCount,
+	NoRole = RoleCount // unknown device beyond them, not read
+};
+
+// how fast temperature of the role may change
+enum Class : uint8_t {
+	Fast,   // boiler water, thermocouple
+	Medium, // mixed feed
+	Slow    // room and outdoor air
+};
+
+inline Role roleOf(const OneWire::Addr& addr) {
+	if (RadiatorAddr() == addr) return Radiator;
+	if (IndoorAddr() == addr) return Indoor;
+	if (OutdoorAddr() == addr) return Outdoor;
+	if (BoilerInAddr() == addr) return BoilerIn;
+	if (BoilerOutAddr() == addr) return BoilerOut;
+	if (HeatOutputAddr() == addr) return HeatOutput;
+	return Other;
+}
+
+// roles of a roster, unknown devices take the Other roles in roster order
+inline void assign(const OneWire::Addr* addrs, uint8_t count, Role* roles) {
+	uint8_t other = 0;
+	for (uint8_t i = 0; i < count; ++i) {
+		Role r = roleOf(addrs[i]);
+		if (r == Other)
+			r = other < OtherCount ? Role(Other + other++) : NoRole;
+		roles[i] = r;
+	}
+}
+
+inline Class classOf(Role role) {
+	switch (role) {
+	case BoilerIn:
+	case BoilerOut:
+	case Thermocouple:
+	case Flue:
+		return Fast;
+	case Radiator:
+	case HeatOutput:
+		return Medium;
+	default:
+		return Slow;
+	}
+}
+
+// role of max6675 channel, see Thermocouples in main.cpp
+inline Role thermocoupleRole(uint8_t channel) {
+	return channel == 0 ? Thermocouple : Flue;
+}
+
+// seconds a reading stays usable by control, twice the longest read period
+inline uint16_t maxAge(Role role) {
+	switch (classOf(role)) {
+	case Fast: return 30;
+	case Medium: return 60;
+	default: return 600;
+	}
+}
+
+} // namespace Sensors
+
+#endif /* SENSORS_H_ */
@@ -0,0 +1,103 @@
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include <inttypes.h>
+
+#include "Clock.h"
+#include "Queue.h"
+#include "Sensors.h"
+#include "temperature.h"
+
+namespace Sensors {
+
+enum Quality : uint8_t {
+	None,   // never read
+	Good,
+	Failed  // last read failed, value is from earlier read
+};
+
+struct Reading {
+	int16_t value;
+	Clock::clock_t time;
+	Quality quality;
+
+	// maxAge is in seconds
+	bool isFresh(Clock::clock_t now, uint16_t maxAge) const {
+		return quality != None && now - time <= Clock::clock_t(maxAge) * 1000;
+	}
+};
+
+struct Frame {
+	Reading reading[RoleCount];
+
+	const Reading& operator[](Role r) const { return reading[r]; }
+	// reading is usable by control, see maxAge()
+	bool isFresh(Role r, Clock::clock_t now) const {
+		return reading[r].isFresh(now, maxAge(r));
+	}
+	Temperature get(Role r, Clock::clock_t now) const {
+		return isFresh(r, now) ? Temperature(reading[r].value) : Temperature();
+	}
+};
+
+/**
+ * Double buffered readings of all roles.
+ * Acquisition writes the back frame and publishes it,
+ * control takes a consistent copy of the front frame.
+ *
+ * Example
+ *
+ * 		snapshot.put(role, t.get(), now);
+ * 		...
+ * 		snapshot.publish();
+ *
+ * 		Sensors::Frame frame = snapshot.read();
+ */
+class Snapshot {
+public:
+	Snapshot() {
+		for (uint8_t i = 0; i < RoleCount; ++i) {
+			Reading& r = frames[0].reading[i];
+			r.value = Temperature::Error;
+			r.time = 0;
+			r.quality = None;
+		}
+		frames[1] = frames[0];
+	}
+	void put(Role r, int16_t value, Clock::clock_t time) {
+		Reading& x = back().reading[r];
+		x.value = value;
+		x.time = time;
+		x.quality = Good;
+	}
+	// keeps previous value and time
+	void fail(Role r) {
+		Reading& x = back().reading[r];
+		if (x.quality != None)
+			x.quality = Failed;
+	}
+	// make back frame visible to control, new back frame starts as its copy
+	void publish() {
+		uint8_t s = seq.load() + 1;
+		seq.store(s);
+		frames[(s + 1) & 1] = frames[s & 1];
+	}
+	Frame read() const {
+		Frame f;
+		uint8_t s;
+		do {
+			s = seq.load();
+			f = frames[s & 1];
+		} while (s != seq.load());
+		return f;
+	}
+private:
+	Frame& back() { return frames[(seq.load() + 1) & 1]; }
+
+	Frame frames[2];
+	Lockfree::Counter seq; // frames[seq & 1] is front
+};
+
+} // namespace Sensors
+
+#endif /* SNAPSHOT_H_ */
@@ -0,0 +1,68 @@
+#include <avr/pgmspace.h>
+
+#include "Stats.h"
+#include "Eeprom.h"
+
+static const char names[Stats::Count][10] PROGMEM = {
+	"uptime",
+	"starts",
+	"burnerOn",
+	"restarts",
+	"pump",
+	"failures",
+	"valve0",
+	"valve1",
+	"valve2",
+	"valve3"
+};
+
+struct Counters {
+	uint32_t v[Stats::Count];
+};
+typedef EepromRing<Counters, EepromLayout::Stats, 2> StatsRing;
+static_assert(EepromLayout::Stats + StatsRing::Size <= EepromLayout::End,
+		"stats do not fit EEPROM");
+static StatsRing ring;
+
+uint32_t Stats::counter[Stats::Count];
+uint16_t Stats::ms[Stats::Count];
+uint32_t Stats::saved;
+
+void Stats::init() {
+	Counters c;
+	if (ring.load(c))
+		for (uint8_t i = 0; i < Count; ++i)
+			counter[i] = c.v[i];
+	saved = counter[Uptime];
+}
+
+void Stats::addTime(Counter c, uint32_t t) {
+	t += ms[c];
+	counter[c] += t / 1000;
+	ms[c] = t % 1000;
+}
+
+void Stats::checkpoint() {
+	if (counter[Uptime] - saved >= CheckpointPeriod)
+		save();
+}
+
+void Stats::save() {
+	Counters c;
+	for (uint8_t i = 0; i < Count; ++i)
+		c.v[i] = counter[i];
+	ring.save(c);
+	saved = counter[Uptime];
+}
+
+void Stats::reset() {
+	for (uint8_t i = 0; i < Count; ++i) {
+		counter[i] = 0;
+		ms[i] = 0;
+	}
+	save();
+}
+
+void Stats::name(Counter c, char* buf) {
+	memcpy_P(buf, names[c], sizeof(names[c]));
+}
@@ -0,0 +1,73 @@
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <inttypes.h>
+
+#include "serial.h"
+
+/**
+ * Persistent 32 bit counters of boiler, pump, valves and sensors.
+ * Counted in RAM, checkpointed to EEPROM every CheckpointPeriod of uptime,
+ * so at most that much is lost on reset. Times are in seconds, ms are
+ * accumulated in RAM.
+ *
+ * Example
+ *
+ * 		Stats::add(Stats::BurnerStarts);
+ * 		Stats::addTime(Stats::PumpTime, elapsed);
+ */
+class Stats {
+public:
+	static const uint8_t MaxValves = 4;
+	enum Counter : uint8_t {
+		Uptime,         // s, base of duty cycles
+		BurnerStarts,   // relay switched on
+		BurnerOnTime,   // s
+		ForcedRestarts, // relay switched off to retry ignition
+		PumpTime,       // s
+		SensorFailures, // failed reads
+		Valve,          // s of drive, + zone index
+		Count = Valve + MaxValves
+	};
+	static const uint16_t CheckpointPeriod = 3600; // s
+
+	// load from EEPROM, zeroes if nothing valid stored
+	static void init();
+	static void add(Counter c, uint32_t n = 1) {
+		counter[c] += n;
+	}
+	static void addTime(Counter c, uint32_t ms);
+	static uint32_t get(Counter c) {
+		return counter[c];
+	}
+	// percent of uptime
+	static uint8_t duty(Counter c) {
+		uint32_t base = counter[Uptime] / 100;
+		return base ? counter[c] / base : 0;
+	}
+	// saves when CheckpointPeriod passed since the last save
+	static void checkpoint();
+	static void save();
+	static void reset();
+	// name of counter for log, up to 9 characters
+	static void name(Counter c, char* buf);
+
+	template <class S>
+	static S& log(S& s) {
+		char buf[10];
+		for (uint8_t i = 0; i < Count; ++i) {
+			name(Counter(i), buf);
+			s << buf << '=' << get(Counter(i));
+			if (i == BurnerOnTime || i == PumpTime)
+				s << ' ' << (unsigned int)duty(Counter(i)) << '%';
+			s << endl;
+		}
+		return s;
+	}
+private:
+	static uint32_t counter[Count];
+	static uint16_t ms[Count];
+	static uint32_t saved; // uptime of the last save
+};
+
+#endif /* STATS_H_ */
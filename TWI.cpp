@@ -0,0 +1,64 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "TWI.h"
+
+Lockfree::Queue<TWI::Message, TWI::QueueSize> TWI::queue;
+volatile bool TWI::active = false;
+volatile uint8_t TWI::failed = 0;
+TWI::Message TWI::current;
+
+static const uint8_t Go = (1<<TWINT)|(1<<TWEN)|(1<<TWIE);
+
+bool TWI::write(uint8_t addr, uint8_t data) {
+	Message m;
+	m.addr = addr;
+	m.data = data;
+	if (!queue.push(m))
+		return false;
+	// TWI_vect clears active only when queue is empty, so it can not miss the message
+	if (!active) {
+		active = true;
+		TWCR = Go | (1<<TWSTA);
+	}
+	return true;
+}
+
+// stop, and start again if there is more to send
+void TWI::next() {
+	if (queue.isEmpty()) {
+		active = false;
+		TWCR = (1<<TWINT)|(1<<TWSTO)|(1<<TWEN);
+	} else {
+		TWCR = Go | (1<<TWSTO) | (1<<TWSTA);
+	}
+}
+
+void TWI::isr() {
+	switch (status()) {
+	case TW_START:
+	case TW_REP_START:
+		queue.pop(current);
+		TWDR = current.addr;
+		TWCR = Go;
+		break;
+	case TW_MT_SLA_ACK:
+		TWDR = current.data;
+		TWCR = Go;
+		break;
+	case TW_MT_DATA_ACK:
+		next();
+		break;
+	default:
+		// not acknowledged or bus error, message is dropped
+		if (failed != 0xFF)
+			failed = failed + 1;
+		next();
+		break;
+	}
+}
+
+ISR(TWI_vect)
+{
+	TWI::isr();
+}
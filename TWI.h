@@ -11,8 +11,20 @@
 #include <avr/io.h>
 #include <util/twi.h>
 
+#include "Queue.h"
+
+/**
+ * Master transmitter of one byte messages, driven by TWI_vect in TWI.cpp.
+ * write() only queues the message, so the main loop never waits for the bus.
+ */
 class TWI {
 public:
+	struct Message {
+		uint8_t addr; // SLA+W
+		uint8_t data;
+	};
+	static const uint8_t QueueSize = 8;
+
 	static void init() {
 		//set SCL to 100kHz
 		TWSR = 0x00;
@@ -22,41 +34,27 @@ public:
 	static void disable() {
 		TWCR = 0;
 	}
-	static void start() {
-		TWCR = (1<<TWINT)|(1<<TWSTA)|(1<<TWEN);
-		wait();
-	}
-	static void stop() {
-		TWCR = (1<<TWINT)|(1<<TWSTO)|(1<<TWEN);
-		while (TWCR & _BV(TWSTO));
-	}
-	static void write(uint8_t data) {
-		TWDR = data;
-		TWCR = (1<<TWINT)|(1<<TWEN);
-		wait();
-	}
-	static bool write(uint8_t addr, uint8_t data) {
-		start();
-		if (status() != TW_START)
-			return false;
-		write(addr);
-		if (status() != TW_MT_SLA_ACK)
-			return false;
-		write(data);
-		if (status() != TW_MT_DATA_ACK)
-			return false;
-		stop();
-		return true;
+	// returns false if queue is full
+	static bool write(uint8_t addr, uint8_t data);
+	// messages not acknowledged
+	static uint8_t errors() {
+		return failed;
 	}
 	static uint8_t status() {
 		uint8_t status;
 		status = TWSR & 0xF8;
 		return status;
 	}
+
+	// TWI_vect in TWI.cpp
+	static void isr();
 private:
-	static void wait() {
-		while ((TWCR & (1<<TWINT)) == 0);
-	}
+	static void next();
+
+	static Lockfree::Queue<Message, QueueSize> queue;
+	static volatile bool active;
+	static volatile uint8_t failed;
+	static Message current;
 };
 
 
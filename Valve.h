@@ -0,0 +1,85 @@
+#ifndef VALVE_H_
+#define VALVE_H_
+
+#include <inttypes.h>
+
+#include "Clock.h"
+
+/**
+ * Estimated position of a mixing valve driven by run time.
+ * Position is ms of drive from the down end stop, 0..Stroke.
+ * Run is signed like Regul output: positive drives down, negative up.
+ * Command into an end stop is allowed for Overrun ms more, this
+ * compensates drift of the estimate, after that it is suppressed.
+ * Every RehomeHours the valve is driven to the down end stop for
+ * Stroke + Overrun to make the estimate exact again.
+ */
+template <uint8_t StrokeSeconds = 120, uint8_t RehomeHours = 24>
+class ValvePosition {
+public:
+	static const int32_t Stroke = StrokeSeconds * 1000L;
+	static const int32_t Overrun = Stroke / 8;
+	static const Clock::clock_t RehomePeriod = RehomeHours * 3600000UL;
+
+	// position is unknown, valve is homed on the first command
+	ValvePosition() : position(Stroke / 2), over(0), homeLeft(Stroke + Overrun), lastHome(0) {}
+
+	// returns run which really moves the valve, limited by maxRun
+	int16_t command(int16_t run, int16_t maxRun, Clock::clock_t now) {
+		if (homeLeft == 0 && now - lastHome >= RehomePeriod)
+			homeLeft = Stroke + Overrun;
+		if (homeLeft != 0) {
+			run = homeLeft > maxRun ? maxRun : homeLeft;
+			homeLeft -= run;
+			if (homeLeft == 0) {
+				position = 0;
+				over = Overrun;
+				lastHome = now;
+			}
+			return run;
+		}
+		if (run > 0) {
+			int32_t room = position + Overrun - (position == 0 ? over : 0);
+			if (run > room)
+				run = room;
+			int32_t p = position - run;
+			if (over > 0 && position != 0)
+				over = 0; // moved away from the up end
+			if (p < 0) {
+				over += -p;
+				p = 0;
+			}
+			position = p;
+		} else if (run < 0) {
+			int32_t room = Stroke - position + Overrun - (position == Stroke ? over : 0);
+			if (-run > room)
+				run = -room;
+			int32_t p = position - run;
+			if (over > 0 && position != Stroke)
+				over = 0; // moved away from the down end
+			if (p > Stroke) {
+				over += p - Stroke;
+				p = Stroke;
+			}
+			position = p;
+		}
+		return run;
+	}
+	bool isHoming() const { return homeLeft != 0; }
+	int32_t get() const { return position; }
+	// position from warm start, no homing is needed
+	void restore(int32_t p) {
+		position = p < 0 ? 0 : p > Stroke ? Stroke : p;
+		over = 0;
+		homeLeft = 0;
+	}
+	// percent open, for log
+	uint8_t percent() const { return position * 100 / Stroke; }
+private:
+	int32_t position;
+	int32_t over;     // drive into the current end stop
+	int32_t homeLeft; // drive left to the down end stop
+	Clock::clock_t lastHome;
+};
+
+#endif /* VALVE_H_ */
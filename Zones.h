@@ -0,0 +1,55 @@
+#ifndef ZONES_H_
+#define ZONES_H_
+
+#include "Cascade.h"
+#include "Plant.h"
+#include "Sensors.h"
+#include "Log.h"
+
+/**
+ * Plant configuration. A zone is a struct of constants for its cascade:
+ *   name()       - for console and log
+ *   gainParam(k) - Params names of p, i, d gains
+ *   Gains        - the same gains in Settings
+ *   Valve        - Action of the mixing valve, Period - ms between steps
+ *   LogChannel   - Log::Channel of cascade messages
+ * and sensor roles of the cascade. Adding a zone is a struct here and
+ * an entry in Zones, main.cpp does not change.
+ */
+struct MainRadiator {
+	static const char* name() { return "radiator"; }
+	static const char* gainParam(uint8_t k) {
+		return k == 0 ? "rP" : k == 1 ? "rI" : "rD";
+	}
+	typedef ::Gains<&Settings::radiatorP, &Settings::radiatorI, &Settings::radiatorD> Gains;
+	typedef Action<Data, 6, 7> Valve;
+	static const uint16_t Period = 20000;
+	static const Log::Channel LogChannel = Log::Radiator;
+	static const Sensors::Role Feed = Sensors::Radiator;
+	static const Sensors::Role Room = Sensors::Indoor;
+	static const Sensors::Role Outdoor = Sensors::Outdoor;
+	static const int16_t Shift = (0_K).get(); // from HeatingCurve
+};
+
+struct MainBoiler {
+	static const char* name() { return "boiler"; }
+	static const char* gainParam(uint8_t k) {
+		return k == 0 ? "bP" : k == 1 ? "bI" : "bD";
+	}
+	typedef ::Gains<&Settings::boilerP, &Settings::boilerI, &Settings::boilerD> Gains;
+	typedef Action<Data, 4, 5> Valve;
+	typedef Action<Data, 3> Pump;
+	static const uint16_t Period = 2500;
+	static const Log::Channel LogChannel = Log::Boiler;
+	static const Sensors::Role In = Sensors::BoilerIn;
+	static const Sensors::Role Out = Sensors::BoilerOut;
+	static const Sensors::Role Flame = Sensors::Thermocouple;
+};
+
+typedef RadiatorCascade<MainRadiator> Radiator;
+typedef BoilerCascade<MainBoiler> Boiler;
+
+// numbered in this order: radiator is zone 0 of masks, registers and Stats
+typedef Plant<Radiator, Boiler> Zones;
+
+#endif /* ZONES_H_ */
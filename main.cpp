@@ -11,9 +11,24 @@ using namespace Mcucpp;
 #include "OneWire.h"
 #include "serial.h"
 #include "TWI.h"
-#include "Cascade.h"
+#include "Zones.h"
 #include "Clock.h"
 #include "spi6675.h"
+#include "Eeprom.h"
+#include "Params.h"
+#include "Console.h"
+#include "Modbus.h"
+#include "Stats.h"
+#include "Log.h"
+#include "Sensors.h"
+#include "Sampler.h"
+#include "Snapshot.h"
+#include "Filter.h"
+#include "Idle.h"
+#include "Autotune.h"
+#include "HeatingCurve.h"
+#include "Burner.h"
+#include "Acquisition.h"
 
 template <class Led>
 struct LedOn {
@@ -27,39 +42,136 @@ typedef OneWire::Wire<IO::Pd2> Wire;
 typedef OneWire::DS1820<Wire> DS1820;
 
 typedef IO::Pd3 MISO;
-typedef IO::Pd4 CS;
+typedef IO::Pd4 FireboxCS;
 typedef IO::Pd5 CLK;
+typedef IO::Pd7 FlueCS;
 typedef IO::Pd6 BOILER_ON;
 
-typedef SPI::max6675<SPI::SPI<CLK, CS, MISO> > max6675;
+// channels in order of Sensors::thermocoupleRole()
+typedef SPI::Bus<CLK, MISO, FireboxCS, FlueCS> ThermocoupleBus;
+typedef SPI::Thermocouples<ThermocoupleBus> Thermocouples;
 
-const static unsigned int cycleTime = 5000; // 5 sec per loop
-const static uint8_t bolierDelay = 600/(cycleTime/1000); // 10 minute
-const static uint8_t bolierDelayOff = 60*15/(cycleTime/1000); // 30 minute
-const static uint8_t bolierRetryDelay = 900/(cycleTime/1000); // 15 minute
-const static int16_t MinFeedTemp = Temperature::toInt(35);
-
-OneWire::ConstAddr<0x10, 0xA1, 0x7B, 0x0F, 0x02, 0x08, 0x00, 0x2E> heatOuputSensor;
+// cycle time and boiler delays are in Params::active
+const static int16_t MinFeedTemp = (35_C).get();
+const static uint16_t warmStartDelay = 600; // 10 minute
+const static uint8_t MaxAddrs = 16;
 
 uint8_t Data::data = 0;
+volatile uint8_t Autotune::request = Autotune::NoRequest;
+
+// number of circles in seconds
+static uint16_t circles(uint16_t seconds)
+{
+	return uint32_t(seconds) * 1000 / Params::active.cycleTime;
+}
+
+// radiator roles whose last good readings are restored
+const static Sensors::Role warmRoles[] = {
+	MainRadiator::Feed, MainRadiator::Room, MainRadiator::Outdoor
+};
+const static uint8_t WarmRoles = sizeof(warmRoles) / sizeof(warmRoles[0]);
+
+// state stored periodically to EEPROM and restored after reset,
+// the version is bumped on any change of WarmStart or of the states in it
+const static uint8_t WarmStartVersion = 7;
+struct WarmStart {
+	uint32_t uptime; // Stats::Uptime of the save, s
+	uint8_t count;
+	OneWire::Addr addrs[MaxAddrs];
+	int16_t readings[WarmRoles]; // of warmRoles, Temperature::Error if stale
+	Zones::State zones;
+	Burner::Saved burner;
+};
+typedef EepromRing<WarmStart, EepromLayout::WarmStart, 4, WarmStartVersion> WarmStartRing;
+static_assert(EepromLayout::WarmStart + WarmStartRing::Size <= EepromLayout::Params,
+		"warm start does not fit EEPROM");
+static_assert(Zones::Count <= Stats::MaxValves, "zones do not fit Stats");
+static_assert(Modbus::Zone + Zones::Count * CascadeRegister::Count <= Modbus::Boiler,
+		"zones do not fit Modbus input registers");
+
+// roster of valid rom codes, readings in range of DS18x20
+static bool isPlausible(const WarmStart& w)
+{
+	if (w.count > MaxAddrs)
+		return false;
+	for (uint8_t i = 0; i < w.count; ++i) {
+		uint8_t crc = 0;
+		for (uint8_t j = 0; j < OneWire::Addr::SIZE - 1; ++j)
+			crc = Wire::crc8(w.addrs[i][j], crc);
+		if (w.addrs[i][OneWire::Addr::SIZE - 1] != crc)
+			return false;
+	}
+	for (uint8_t i = 0; i < WarmRoles; ++i) {
+		int16_t v = w.readings[i];
+		if (v != Temperature::Error && (v < DS1820::MinValue || v > DS1820::MaxValue))
+			return false;
+	}
+	return true;
+}
+
+// Uptime is checkpointed every Stats::CheckpointPeriod and a snapshot is
+// saved every warmStartDelay, so a snapshot of the last run is close to the
+// checkpoint; an older one is left from a run whose saves failed
+static bool isRecent(const WarmStart& w, uint32_t uptime)
+{
+	return w.uptime + 2 * warmStartDelay >= uptime
+			&& w.uptime <= uptime + Stats::CheckpointPeriod + 2 * warmStartDelay;
+}
+
+// served by serve() whenever main() waits, set by main()
+static Zones* valves = 0;
+static Acquisition<DS1820>* conversion = 0;
+static Modbus* slave = 0;
+static SerialPort<9600>* port = 0;
+
+// work that can not wait for the end of the cycle: valves are stopped at
+// the end of their drive time, strong pull-up is ended after conversion,
+// Modbus requests are answered
+static void serve()
+{
+	Clock::clock_t now = Clock::millis();
+	if (valves && valves->stopRuns(now))
+		TWI::write(0x40, ~Data::data);
+	if (conversion)
+		conversion->release(now);
+	if (slave && Modbus::isEnabled())
+		slave->poll(*port, now);
+}
+
+// sleeps until the next valve stop or deadline
+static void sleep(Clock::clock_t deadline)
+{
+	serve();
+	Idle::sleep(valves ? valves->nextStop(deadline) : deadline);
+}
 
 void delay_ms(uint16_t t)
 {
-	for (uint16_t i = 0; i < t; ++i)
-		_delay_ms(1);
+	Clock::clock_t deadline = Clock::millis() + t;
+	while (!Idle::isPassed(deadline))
+		sleep(deadline);
+	serve();
 }
 
 int main(void)
 {
 	sei();
 	Clock::start();
+	Params::init();
+	HeatingCurve::init();
+	Stats::init();
 
 	TWI::init();
 	TWI::write(0x40, 255);
 
-	max6675::SPI::start();
+	ThermocoupleBus::start();
 
 	SerialPort<9600> com;
+	Console<SerialPort<9600>, Zones> console(com);
+	Modbus modbus;
+	slave = &modbus;
+	port = &com;
+	SerialTx::muted = Modbus::isEnabled();
 
 	Led::SetDirWrite();
 
@@ -69,142 +181,299 @@ int main(void)
 
 	com << "Starting on 9600" << endl;
 
-	RadiatorCascade radiatorCascade;
-	BoilerCascade boilerCascade;
-	const uint8_t MaxAddrs = 16;
+	Zones zones;
+	valves = &zones;
+	Radiator& radiator = zones.get<Radiator>();
 	OneWire::Addr addrs[MaxAddrs];
+	Sensors::Role roles[MaxAddrs];
+	OneWire::DeviceStats devices[MaxAddrs] = {};
+	Sampler sampler;
+	Acquisition<DS1820> acquisition;
+	conversion = &acquisition;
+	Sensors::Snapshot snapshot;
+	Sensors::Filters filters;
+	Thermocouples thermocouples;
 	uint16_t fails = 0;
-	uint8_t boilerCircles = bolierDelay;
-	uint8_t boilerCirclesOn = 0;
-	bool boilerOn = false;
-	bool boilerStatus = false;
-	bool boilerRealStatus = false;
+	Burner burner;
+
+	WarmStartRing warmStartRing;
+	WarmStart warmStart;
+	uint16_t warmStartCircles = 0;
+	uint8_t roster = 0; // devices found by last successful search
+	uint8_t restored = 0;
+	bool detect = true; // power supply of devices, once the roster is new
+	bool holdRelay = false; // until the thermocouple is read after warm start
+	if (warmStartRing.load(warmStart) && isPlausible(warmStart)) {
+		// devices do not change while the power is off
+		restored = roster = warmStart.count;
+		for (uint8_t i = 0; i < roster; ++i)
+			addrs[i] = warmStart.addrs[i];
+		Sensors::assign(addrs, roster, roles);
+		// brown-out or power cut alike, the snapshot tells if it is of the last run
+		if (isRecent(warmStart, Stats::get(Stats::Uptime))) {
+			zones.restore(warmStart.zones);
+			burner.restore(warmStart.burner, Clock::millis());
+			holdRelay = burner.isOn();
+			for (uint8_t i = 0; i < WarmRoles; ++i)
+				if (warmStart.readings[i] != Temperature::Error)
+					snapshot.put(warmRoles[i], warmStart.readings[i], Clock::millis());
+			snapshot.publish();
+			com << "Warm start" << endl;
+		} else {
+			com << "Warm start, roster only" << endl;
+		}
+	}
 
+	bool relay = false;
+	Clock::clock_t lastStart = Clock::millis();
 	for(;;)
 	{
 		Clock::clock_t startTime = Clock::millis();
 
-		com << "Search ";
-		uint8_t count = 0;
-		OneWire::Search<Wire> search;
-		{
-			LedOn<Led> l;
-			do {
-				addrs[count++] = search();
-			} while (!search.isDone() && count < MaxAddrs);
-		}
-		if (search.isFail())
-		{
-			com << "failed on " << int(count) << ": " << search.error();
-			search.errorDetail(com) <<  endl;
-			fails++;
-		} else {
-			com << int(count) << endl;
-			fails = 0;
+		// relay and pump kept their state since the previous cycle
+		uint32_t elapsed = startTime - lastStart;
+		lastStart = startTime;
+		Stats::addTime(Stats::Uptime, elapsed);
+		if (relay)
+			Stats::addTime(Stats::BurnerOnTime, elapsed);
+		if (MainBoiler::Pump::status())
+			Stats::addTime(Stats::PumpTime, elapsed);
+		Stats::checkpoint();
+
+		if (Params::apply()) {
+			zones.configure();
+			// Modbus master does not expect anything unsolicited
+			SerialTx::muted = Modbus::isEnabled();
+			LOG(com, Log::Timing, Log::Info) << "Params applied" << endl;
 		}
+		zones.tune(Autotune::request, startTime);
+		Autotune::request = Autotune::NoRequest;
 
-		if (!Wire::reset())
+		// read sensors converted during the previous cycle, addrs are of its search
+		uint16_t due = acquisition.finish(delay_ms);
+		for (uint8_t i = 0; i < MaxAddrs; ++i)
 		{
-			com << "Reset failed" << endl;
-			fails++;
-			continue;
+			if (due & (1u << i)) {
+				Sensors::Role role = roles[i];
+				Led::Set();
+				// spikes are removed by filters, one retry for bus errors is enough
+				Temperature t = DS1820::read<2>(addrs[i], devices[i],
+						OneWire::ReadMode(Params::active.readMode));
+				Led::Clear();
+
+				int16_t v;
+				if (!t.isValid()) {
+					snapshot.fail(role);
+					LOG(com, Log::Sensors, Log::Error) << "Fail  " << addrs[i] << endl;
+					fails++;
+					Stats::add(Stats::SensorFailures);
+				} else if (filters.put(role, t.get(), Clock::millis(), v)) {
+					sampler.update(role, v, startTime);
+					snapshot.put(role, v, Clock::millis());
+					acquisition.sampled(role, acquisition.age(Clock::millis()));
+					LOG(com, Log::Sensors, Log::Info) << "Temp: " << addrs[i] << '=' << t << ' ' << Temperature(v) << endl;
+				} else {
+					// dropped, read again at next cycle
+					LOG(com, Log::Sensors, Log::Warn) << "Drop  " << addrs[i] << '=' << t << endl;
+				}
+			}
 		}
 
-		{
-			LedOn<Led> l;
-			Wire::skip();
-			DS1820::convert();
-			com << "Radiator " << radiatorCascade << endl;
-			com << "Boiler   " << boilerCascade << endl;
-			DS1820::wait();
+		for (uint8_t i = 0; i < Thermocouples::Count; ++i) {
+			Sensors::Role role = Sensors::thermocoupleRole(i);
+			if (!sampler.due(role, startTime))
+				continue;
+			Temperature t = thermocouples.temperature(i, Clock::millis());
+			int16_t v;
+			if (t.isValid() && filters.put(role, t.get(), Clock::millis(), v)) {
+				sampler.update(role, v, startTime);
+				snapshot.put(role, v, Clock::millis());
+				acquisition.sampled(role, thermocouples.age(i, Clock::millis()));
+				LOG(com, Log::Sensors, Log::Info) << "Temp: TC" << int(i) << '=' << t << ' ' << Temperature(v) << endl;
+			} else {
+				snapshot.fail(role);
+				LOG(com, Log::Sensors, Log::Error) << (thermocouples.isOpen(i) ? "Open  TC" : "Fail  TC") << int(i) << endl;
+				fails++;
+				Stats::add(Stats::SensorFailures);
+			}
 		}
+		snapshot.publish();
+		serve();
 
-		Temperature heatOutput;
-		for (int i = 0; i < count; ++i)
-		{
-			Led::Set();
-			Temperature t = DS1820::read(addrs[i]);
-			Led::Clear();
+		LOG(com, Log::Sensors, Log::Info) << "Temp: fails=" << fails << endl;
 
-			if (t.isValid()) {
-				if (heatOuputSensor == addrs[i])
-					heatOutput = t;
-				radiatorCascade.processSensor(addrs[i], t.get());
-				boilerCascade.processSensor(addrs[i], t.get());
-
-				com << "Temp: " << addrs[i] << '=' << t << endl;
-			} else {
-				com << "Fail  " << addrs[i] << endl;
+		LOG(com, Log::Bus, Log::Info) << "Search ";
+		uint8_t count = 0;
+		if (restored) {
+			// first circle after warm start, use saved roster
+			count = restored;
+			restored = 0;
+			LOG(com, Log::Bus, Log::Info) << "restored " << int(count) << endl;
+		} else {
+			OneWire::Search<Wire> search;
+			{
+				LedOn<Led> l;
+				do {
+					OneWire::Addr a = search();
+					// statistics belong to the device, not to its position
+					if (a != addrs[count]) {
+						devices[count] = OneWire::DeviceStats();
+						detect = true;
+					}
+					addrs[count++] = a;
+				} while (!search.isDone() && count < MaxAddrs);
+			}
+			if (search.isFail())
+			{
+				if (LOG_ON(Log::Bus, Log::Info)) {
+					com << "failed on " << int(count) << ": " << search.error();
+					search.errorDetail(com) <<  endl;
+				}
 				fails++;
+			} else {
+				LOG(com, Log::Bus, Log::Info) << int(count) << endl;
+				fails = 0;
+				detect |= count != roster;
+				roster = count;
 			}
+			Sensors::assign(addrs, count, roles);
+		}
+		if (count && detect) {
+			bool parasite = DS1820::isParasite();
+			detect = !DS1820::detectPower();
+			if (!detect && DS1820::isParasite() != parasite)
+				LOG(com, Log::Bus, Log::Info) << (parasite ? "External power" : "Parasite power") << endl;
 		}
 
-		Temperature tc = max6675::temperature();
-		if (tc.isValid()) {
-			boilerCascade.processTC(tc.get());
-			com << "Temp: TC=" << tc << endl;
-		} else {
-			com << "Fail  TC" << endl;
-			fails++;
+		// convert only sensors due by sampler at the next cycle, each one selected
+		// by rom; parasite powered ones all at once, the bus is held high while
+		// they convert, until their conversion time has passed
+		Clock::clock_t next = startTime + Params::active.cycleTime;
+		due = 0;
+		{
+			LedOn<Led> l;
+			for (uint8_t i = 0; i < count; ++i)
+			{
+				if (roles[i] == Sensors::NoRole || !sampler.due(roles[i], next))
+					continue;
+				if (DS1820::isParasite()) {
+					due |= 1u << i;
+					continue;
+				}
+				if (!Wire::reset())
+				{
+					LOG(com, Log::Bus, Log::Error) << "Reset failed" << endl;
+					fails++;
+					break;
+				}
+				Wire::select(addrs[i]);
+				DS1820::convert();
+				due |= 1u << i;
+			}
+			if (due && DS1820::isParasite()) {
+				if (Wire::reset()) {
+					Wire::skip();
+					DS1820::convert();
+				} else {
+					LOG(com, Log::Bus, Log::Error) << "Reset failed" << endl;
+					fails++;
+					due = 0;
+				}
+			}
 		}
+		acquisition.start(due, Clock::millis());
+		serve();
+		zones.log(com);
 
-		com << "Temp: fails=" << fails << endl;
+		// control works on a consistent copy of the readings
+		Clock::clock_t now = Clock::millis();
+		Sensors::Frame frame = snapshot.read();
+		Temperature heatOutput = frame.get(Sensors::HeatOutput, now);
+		Temperature tc = frame.get(Sensors::Thermocouple, now);
 
-		if (!radiatorCascade.step())
-			com << "Radiator Cascade fail" << endl;
-		if (!boilerCascade.step())
-			com << "Boiler Cascade fail" << endl;
+		// each cascade runs with its own period, outputs are pulsed only after a step
+		uint8_t stepped = zones.step(frame, now, com);
+		zones.storeTuning(com);
+		zones.countTravel(stepped);
 
 
-		boilerOn = radiatorCascade.getOutput() < (boilerRealStatus ? 50 : -100)
-				|| (heatOutput.get() < radiatorCascade.getTarget() +(boilerRealStatus ? 5 : 0)
+		bool burnerOn = burner.isOn();
+		bool boilerOn = radiator.getOutput() < (burnerOn ? 50 : -100)
+				|| (heatOutput.get() < radiator.getTarget() +(burnerOn ? 5 : 0)
 						&& heatOutput.isValid())
 				|| (heatOutput.get() < MinFeedTemp && heatOutput.isValid());
-		if (boilerOn != boilerStatus) {
-			boilerCircles = boilerOn ? bolierDelay : bolierDelayOff;
-			boilerCirclesOn = 0;
-			boilerStatus = boilerOn;
+		Burner::State before = burner.getState();
+		if (burner.step(boilerOn, tc, now)) {
+			if (burner.getState() == Burner::Restart)
+				Stats::add(Stats::ForcedRestarts);
+			// on again after a Restart is counted there, not as a start
+			if ((before == Burner::Off || before == Burner::Starting) && burner.isOn())
+				Stats::add(Stats::BurnerStarts);
+			if (LOG_ON(Log::Boiler, Log::Info)) {
+				char name[10];
+				Burner::name(burner.getState(), name);
+				com << "Burner " << name << " slope=" << TemperatureDelta(burner.slope()) << endl;
+			}
 		}
-		if (boilerCircles != 0)
-			boilerCircles--;
-		else {
-			if (boilerStatus && boilerCirclesOn != 255)
-				boilerCirclesOn++;
-			if (tc.get() < boilerCascade.TCHigh && boilerCirclesOn > bolierRetryDelay)
-				boilerStatus = false; // turn boiler off temporary to trigger burning
-			BOILER_ON::Set(boilerStatus);
-			boilerRealStatus = boilerStatus;
+		if (tc.isValid())
+			holdRelay = false;
+		relay = burner.isOn() && !holdRelay;
+		BOILER_ON::Set(relay);
+		LedOn<Led> l(relay);
+
+		LOG(com, Log::Boiler, Log::Info) << "Temp: boiler=" << relay << endl;
+
+		if (++warmStartCircles >= circles(warmStartDelay)) {
+			warmStartCircles = 0;
+			warmStart.uptime = Stats::get(Stats::Uptime);
+			warmStart.count = roster;
+			for (uint8_t i = 0; i < roster; ++i)
+				warmStart.addrs[i] = addrs[i];
+			for (uint8_t i = 0; i < WarmRoles; ++i)
+				warmStart.readings[i] = frame.get(warmRoles[i], now).get();
+			zones.save(warmStart.zones);
+			burner.save(warmStart.burner, Clock::millis());
+			warmStartRing.save(warmStart);
+
+			if (LOG_ON(Log::Bus, Log::Info)) {
+				com << "Bus: " << Wire::stats << endl;
+				com << "Bus: " << DS1820::readStats << endl;
+				for (uint8_t i = 0; i < roster; ++i)
+					if (!devices[i].isClean())
+						com << "Bus: " << addrs[i] << ' ' << devices[i] << endl;
+			}
 		}
-		LedOn<Led> l(boilerRealStatus);
-
-		com << "Temp: boiler=" << boilerRealStatus << endl;
-
-		//Clock::clock_t regStart = Clock::millis();
-		int16_t rDelay = radiatorCascade.getAbsOutput();
-		int16_t bDelay = boilerCascade.getAbsOutput();
 
+		// valves of stepped zones start together, each one is stopped after its
+		// drive time by serve() while waiting, in this cycle or the next ones
+		LOG(com, Log::Actuation, Log::Debug) << "Pulse " << int(stepped) << " twi errors="
+				<< int(TWI::errors()) << endl;
 		TWI::write(0x40, ~Data::data);
-		if (rDelay > 0 || bDelay > 0) {
-			if (rDelay < bDelay) {
-				delay_ms(rDelay);
-				RadiatorCascade::action_t::stop();
-				TWI::write(0x40, ~Data::data);
-				delay_ms(bDelay - rDelay);
-				BoilerCascade::action_t::stop();
-				TWI::write(0x40, ~Data::data);
-			} else {
-				delay_ms(bDelay);
-				BoilerCascade::action_t::stop();
-				TWI::write(0x40, ~Data::data);
-				delay_ms(rDelay - bDelay);
-				RadiatorCascade::action_t::stop();
-				TWI::write(0x40, ~Data::data);
-			}
-		}
+		zones.startRuns(stepped, Clock::millis());
 		Clock::clock_t regStop = Clock::millis();
-		com << "cycle time " << regStop - startTime << endl;
-		if (cycleTime > (regStop - startTime))
-			delay_ms(cycleTime - (regStop - startTime));
+		if (LOG_ON(Log::Timing, Log::Info)) {
+			com << "cycle time " << (unsigned int)(regStop - startTime) << ' ';
+			Idle::log(com) << ' ';
+			acquisition.log(com) << endl;
+		}
+
+		for (uint8_t r = 0; r < Sensors::RoleCount; ++r)
+			modbus.input[Modbus::Sensor + r] = frame.get(Sensors::Role(r), now).get();
+		zones.registers(modbus.input + Modbus::Zone);
+		modbus.input[Modbus::BoilerOn] = burner.isWanted();
+		modbus.input[Modbus::BoilerBurner] = relay;
+		modbus.input[Modbus::BurnerState] = burner.getState();
+		modbus.input[Modbus::Fails] = fails;
+		modbus.input[Modbus::CycleTime] = regStop - startTime;
+
+		// serve commands while waiting for the next cycle, Modbus requests
+		// are answered by serve() all the cycle long
+		Clock::clock_t deadline = startTime + Params::active.cycleTime;
+		while (!Idle::isPassed(deadline)) {
+			if (!Modbus::isEnabled())
+				console.poll();
+			sleep(deadline);
+		}
 	}
 }
 
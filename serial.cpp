@@ -0,0 +1,23 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "serial.h"
+
+Lockfree::Queue<char, 64> SerialRx::queue;
+Lockfree::Queue<uint8_t, 4> SerialRx::starts;
+Lockfree::Shared<Clock::clock_t> SerialRx::last;
+uint8_t SerialRx::pushed;
+uint8_t SerialRx::taken;
+bool SerialTx::muted;
+
+ISR(USART_RX_vect)
+{
+	char c = UDR0;
+	Clock::clock_t now = Clock::millis();
+	if (!SerialRx::queue.push(c))
+		return; // dropped on overflow
+	if (now - SerialRx::last.get() >= SerialRx::FrameGap)
+		SerialRx::starts.push(SerialRx::pushed);
+	SerialRx::last.set(now);
+	++SerialRx::pushed;
+}
@@ -15,6 +15,35 @@
 #define sbi(sfr, bit) (_SFR_BYTE(sfr) |= _BV(bit))
 #endif
 
+#include <string.h>
+
+#include "Queue.h"
+#include "Clock.h"
+#include "Format.h"
+
+// Receive queue, filled by USART_RX_vect in serial.cpp
+struct SerialRx {
+	static const uint8_t FrameGap = 4; // ms, silence of 3.5 characters at 9600
+	static Lockfree::Queue<char, 64> queue;
+	// number of the byte after FrameGap silence, counted by pushed bytes
+	static Lockfree::Queue<uint8_t, 4> starts;
+	static Lockfree::Shared<Clock::clock_t> last; // time of the last byte
+	static uint8_t pushed; // ISR only
+	static uint8_t taken;  // main only
+
+	static bool get(char& c)
+	{
+		if (!queue.pop(c))
+			return false;
+		++taken;
+		return true;
+	}
+};
+
+// Text output is dropped while muted, write() still sends
+struct SerialTx {
+	static bool muted;
+};
 
 
 template <unsigned long baud,
@@ -29,9 +58,23 @@ class SerialPort
     volatile uint8_t *ucsrb() { return &UCSR0B;}
     volatile uint8_t *udr() { return &UDR0;}
 
-    const char* digits;
+    uint8_t width;
+    char fill;
+    uint8_t base;
+
+    // s with sign, padded to width, which is used once
+    void pad(const char* s, uint8_t len, bool negative)
+    {
+    	Format::pad(*this, s, len, negative, width, fill);
+    	width = 0;
+    }
+    void number(uint32_t n, bool negative)
+    {
+    	Format::number(*this, n, negative, width, fill, base);
+    	width = 0;
+    }
 public:
-    SerialPort() : digits("0123456789ABCDEF")
+    SerialPort() : width(0), fill(' '), base(10)
 	{
 
 		uint16_t baud_setting;
@@ -62,9 +105,22 @@ public:
 		*ubrrh() = baud_setting >> 8;
 		*ubrrl() = baud_setting;
 
-		//sbi(*ucsrb(), _rxen);
+		sbi(*ucsrb(), _rxen);
 		sbi(*ucsrb(), _txen);
-		//sbi(*ucsrb(), _rxcie);
+		sbi(*ucsrb(), _rxcie);
+	}
+
+	// text output, dropped while muted
+	void put(char c)
+	{
+		if (!SerialTx::muted)
+			write(c);
+	}
+
+	// non blocking, returns false if nothing received
+	bool read(char& c)
+	{
+		return SerialRx::get(c);
 	}
 
 	void write(char c)
@@ -76,51 +132,64 @@ public:
 
 	SerialPort& operator<< (char c)
 	{
-		write(c);
+		put(c);
 		return *this;
 	}
 	SerialPort& operator<< (bool b)
 	{
-		write(b ? '1' : '0');
+		put(b ? '1' : '0');
 		return *this;
 	}
 	SerialPort& operator<< (const char* s)
 	{
-		while(*s) write(*(s++));
+		if (width) {
+			uint8_t len = strlen(s);
+			pad(s, len, false);
+		} else {
+			while(*s) put(*(s++));
+		}
 		return *this;
 	}
+	// two hex digits, as bytes of addresses are printed
 	SerialPort& operator<< (uint8_t i)
 	{
-		write(digits[i>>4]);
-		write(digits[i&15]);
+		put(Format::digit(i >> 4));
+		put(Format::digit(i & 15));
 		return *this;
 	}
 	SerialPort& operator<< (int n)
 	{
-		if (n < 0) {
-			write('-');
-			n = -n;
-		}
-
-		return *this << (unsigned int)n;
+		number(n < 0 ? -(unsigned int)n : n, n < 0);
+		return *this;
 	}
 	SerialPort& operator<< (unsigned int n)
 	{
-		if (n == 0)
-		{
-			write('0');
-			return *this;
-		}
-		uint8_t buf[6];
-		long i = 0;
-		while(n > 0)
-		{
-		    buf[i++] = n % 10;
-		    n /= 10;
-		}
-		for (--i; i >= 0; --i)
-			write(digits[buf[i]]);
-
+		number(n, false);
+		return *this;
+	}
+	SerialPort& operator<< (long n)
+	{
+		number(n < 0 ? -(unsigned long)n : n, n < 0);
+		return *this;
+	}
+	SerialPort& operator<< (unsigned long n)
+	{
+		number(n, false);
+		return *this;
+	}
+	SerialPort& operator<< (Format::Width w)
+	{
+		width = w.n;
+		return *this;
+	}
+	SerialPort& operator<< (Format::Fill f)
+	{
+		fill = f.c;
+		return *this;
+	}
+	SerialPort& operator<< (Format::Base b)
+	{
+		base = b.n;
 		return *this;
 	}
 	SerialPort& operator<< (SerialPort& (*pf)(SerialPort&))
@@ -132,7 +201,7 @@ public:
 template <unsigned long b, uint8_t A6,uint8_t A7,uint8_t A8,uint8_t A9,uint8_t A10>
 inline SerialPort<b,A6,A7,A8,A9,A10>& endl(SerialPort<b,A6,A7,A8,A9,A10>& p)
 {
-	p.write('\r'); p.write('\n');
+	p << '\r' << '\n';
 	return p;
 }
 
@@ -5,42 +5,82 @@
 #include <inttypes.h>
 #include <util/delay.h>
 
+#include "Clock.h"
 #include "temperature.h"
 
 namespace SPI
 {
 
-template <class CLK, class CS, class MISO>
-class SPI
+// chip selects in order of index, high is idle
+template <class... CS>
+struct Select;
+
+template <>
+struct Select<>
+{
+  static void start() {}
+  static void stop() {}
+  static void set(uint8_t, bool) {}
+};
+
+template <class CS, class... Rest>
+struct Select<CS, Rest...>
+{
+  static void start()
+  {
+	CS::Set();
+	CS::SetDirWrite();
+	Select<Rest...>::start();
+  }
+  static void stop()
+  {
+	CS::SetDirRead();
+	Select<Rest...>::stop();
+  }
+  static void set(uint8_t i, bool level)
+  {
+	if (i == 0)
+	  CS::Set(level);
+	else
+	  Select<Rest...>::set(i - 1, level);
+  }
+};
+
+/**
+ * Read only bus, CLK and MISO are shared by all chips.
+ * Chip i is selected by i-th pin of CS.
+ */
+template <class CLK, class MISO, class... CS>
+class Bus
 {
   public:
+  static const uint8_t Count = sizeof...(CS);
 
   static void start()
   {
 	CLK::SetDirWrite();
-	CS::SetDirWrite();
 	MISO::SetDirRead();
-
-	disable();
+	Select<CS...>::start();
   }
 
   static void stop()
   {
 	CLK::SetDirRead();
-	CS::SetDirRead();
 	MISO::SetDirRead();
+	Select<CS...>::stop();
   }
 
-  static void enable()
+  static void enable(uint8_t i = 0)
   {
-	CS::Clear();
+	Select<CS...>::set(i, false);
   }
 
-  static void disable()
+  static void disable(uint8_t i = 0)
   {
-	CS::Set();
+	Select<CS...>::set(i, true);
   }
 
+  // MSB first, data is valid while CLK is low
   static uint8_t read()
   {
 	  uint8_t d = 0;
@@ -48,39 +88,104 @@ class SPI
 	  for (int i=7; i>=0; i--)
 	  {
 	    CLK::Clear();
-	    _delay_ms(1);
+	    _delay_us(1);
 	    if (MISO::IsSet()) {
 	      d |= (1 << i);
 	    }
 
 	    CLK::Set();
-	    _delay_ms(1);
+	    _delay_us(1);
 	  }
 
 	  return d;
 	}
 };
 
+// one chip bus, as it was before Bus
+template <class CLK, class CS, class MISO>
+using SPI = Bus<CLK, MISO, CS>;
+
 template <class Spi>
 class max6675
 {
 public:
   typedef Spi SPI;
-  static Temperature temperature()
+  static const uint16_t Open = 0x4; // D2, thermocouple input is open
+
+  // 16 bit frame of chip i, reading aborts conversion, the next one starts after it
+  static uint16_t raw(uint8_t i = 0)
   {
-	  Spi::enable();
-	  _delay_ms(1);
-	  int16_t t = Spi::read();
+	  Spi::enable(i);
+	  _delay_us(1);
+	  uint16_t t = Spi::read();
 	  t <<= 8;
 	  t |= Spi::read();
-	  Spi::disable();
-
-	  if (t & 0x4)
+	  Spi::disable(i);
+	  return t;
+  }
+  static Temperature toTemperature(uint16_t t)
+  {
+	  if (t & Open)
 		  return Temperature();
-	  t >>= 3;
-	  t <<= 2;
-	  return Temperature(t);
+	  // 0.25 degree in D14..D3
+	  return Temperature(int16_t((t >> 3) << 2));
+  }
+  static Temperature temperature(uint8_t i = 0)
+  {
+	  return toTemperature(raw(i));
+  }
+};
+
+/**
+ * All max6675 chips of Spi bus, each one is read only after its conversion
+ * is done, cached value is returned before that.
+ *
+ * Example
+ *
+ * 		Temperature t = thermocouples.temperature(i, Clock::millis());
+ * 		if (thermocouples.isOpen(i))
+ * 			...
+ */
+template <class Spi>
+class Thermocouples
+{
+public:
+  typedef max6675<Spi> Chip;
+  static const uint8_t Count = Spi::Count;
+  static const uint16_t ConversionTime = 220; // ms, max of datasheet
+
+  Thermocouples()
+  {
+	  for (uint8_t i = 0; i < Count; ++i)
+		  channel[i].read = false;
+  }
+  // invalid if the input is open
+  Temperature temperature(uint8_t i, Clock::clock_t now)
+  {
+	  Channel& c = channel[i];
+	  if (!c.read || now - c.time >= ConversionTime) {
+		  c.raw = Chip::raw(i);
+		  c.time = now;
+		  c.read = true;
+	  }
+	  return Chip::toTemperature(c.raw);
+  }
+  // ms since the chip was read, its conversion ended then
+  uint16_t age(uint8_t i, Clock::clock_t now) const
+  {
+	  return now - channel[i].time;
+  }
+  bool isOpen(uint8_t i) const
+  {
+	  return channel[i].read && (channel[i].raw & Chip::Open);
   }
+private:
+  struct Channel {
+	  Clock::clock_t time; // of the last read, conversion started then
+	  uint16_t raw;
+	  bool read;
+  };
+  Channel channel[Count];
 };
 
 } //namespace SPI
@@ -8,35 +8,174 @@
 #ifndef TEMPERATURE_H_
 #define TEMPERATURE_H_
 
+#include <inttypes.h>
+
+#include "Format.h"
+
+/**
+ * Fixed point 12.4, saturating 16 bit arithmetic.
+ * add, sub and mul detect overflow on 16 bit values, with no 32 bit math
+ * at runtime. saturate() narrows 32 bit results of compile time
+ * conversions and of callers that need wider intermediates.
+ */
+namespace Fixed {
+
+const uint8_t FracBits = 4;
+const int16_t One = 1 << FracBits;
+const int16_t MaxValue = 0x7FFF;
+const int16_t MinValue = -0x7FFF - 1;
+
+// nearest, half away from zero; for compile time conversions
+constexpr int16_t fromReal(long double v) {
+	return v >= MaxValue ? MaxValue : v <= MinValue ? MinValue
+			: int16_t(v >= 0 ? v + 0.5 : v - 0.5);
+}
+constexpr int16_t saturate(int32_t v) {
+	return v > MaxValue ? MaxValue : v < MinValue ? MinValue : int16_t(v);
+}
+inline int16_t add(int16_t a, int16_t b) {
+	int16_t r = uint16_t(a) + uint16_t(b);
+	if (((a ^ r) & (b ^ r)) < 0)
+		r = a < 0 ? MinValue : MaxValue;
+	return r;
+}
+inline int16_t sub(int16_t a, int16_t b) {
+	int16_t r = uint16_t(a) - uint16_t(b);
+	if (((a ^ b) & (a ^ r)) < 0)
+		r = a < 0 ? MinValue : MaxValue;
+	return r;
+}
+// a * k as (high byte * k) * 256 + low byte * k, both 8 x 8 bit products,
+// the result fits if its high byte does
+inline int16_t mul(int16_t a, int8_t k) {
+	int16_t lo = int16_t(uint8_t(a)) * k;
+	int16_t hi = int16_t(int8_t(a >> 8)) * k + (lo >> 8);
+	if (hi > INT8_MAX || hi < INT8_MIN)
+		return hi < 0 ? MinValue : MaxValue;
+	return int16_t(uint16_t(hi) << 8 | uint8_t(lo));
+}
+// nearest, half away from zero, d > 0; remainder is compared, not added,
+// so the result does not saturate near the limits
+inline int16_t div(int16_t a, int16_t d) {
+	int16_t q = a / d, r = a % d;
+	if (r >= 0 ? r >= d - r : -r >= d + r)
+		q += r >= 0 ? 1 : -1;
+	return q;
+}
+
+} // namespace Fixed
+
+class TemperatureDelta
+{
+public:
+	constexpr TemperatureDelta() : value(0) {}
+	constexpr explicit TemperatureDelta(int16_t v) : value(v) {}
+	constexpr int16_t get() const { return value; }
+	constexpr static TemperatureDelta fromDegrees(long double v) {
+		return TemperatureDelta(Fixed::fromReal(v * Fixed::One));
+	}
+
+	constexpr TemperatureDelta operator-() const {
+		return TemperatureDelta(value == Fixed::MinValue ? Fixed::MaxValue : -value);
+	}
+	TemperatureDelta operator+(TemperatureDelta x) const { return TemperatureDelta(Fixed::add(value, x.value)); }
+	TemperatureDelta operator-(TemperatureDelta x) const { return TemperatureDelta(Fixed::sub(value, x.value)); }
+	TemperatureDelta operator*(int8_t k) const { return TemperatureDelta(Fixed::mul(value, k)); }
+	// rounds to nearest
+	TemperatureDelta operator/(int16_t d) const { return TemperatureDelta(Fixed::div(value, d)); }
+	TemperatureDelta abs() const { return value < 0 ? -*this : *this; }
+
+	constexpr bool operator==(TemperatureDelta x) const { return value == x.value; }
+	constexpr bool operator!=(TemperatureDelta x) const { return value != x.value; }
+	constexpr bool operator<(TemperatureDelta x) const { return value < x.value; }
+	constexpr bool operator>(TemperatureDelta x) const { return value > x.value; }
+	constexpr bool operator<=(TemperatureDelta x) const { return value <= x.value; }
+	constexpr bool operator>=(TemperatureDelta x) const { return value >= x.value; }
+private:
+	int16_t value;
+};
 
 class Temperature
 {
 public:
 
-	Temperature() : value(Error) {}
-	Temperature(int16_t v) : value(v) {}
-	Temperature(uint8_t v, uint8_t frac) : value(v*256 + frac) {}
-	int16_t get() const { return value; }
-	bool isValid() { return value != Error; }
+	constexpr Temperature() : value(Error) {}
+	constexpr explicit Temperature(int16_t v) : value(v) {}
+	constexpr Temperature(uint8_t v, uint8_t frac) : value(int16_t(uint16_t(v) << 8 | frac)) {}
+	constexpr int16_t get() const { return value; }
+	constexpr bool isValid() const { return value != Error; }
 
-	constexpr static inline int16_t toInt(int8_t v) { return v*16; }
+	constexpr static inline int16_t toInt(int16_t v) { return Fixed::saturate(int32_t(v) * Fixed::One); }
+	constexpr static Temperature fromCelsius(long double v) {
+		return Temperature(Fixed::fromReal(v * Fixed::One));
+	}
 	static const int16_t Error = -127*16;
+
+	constexpr Temperature operator-() const {
+		return Temperature(value == Fixed::MinValue ? Fixed::MaxValue : -value);
+	}
+	Temperature operator+(TemperatureDelta x) const { return Temperature(Fixed::add(value, x.get())); }
+	Temperature operator-(TemperatureDelta x) const { return Temperature(Fixed::sub(value, x.get())); }
+	TemperatureDelta operator-(Temperature x) const { return TemperatureDelta(Fixed::sub(value, x.value)); }
+	// distance from 0 degree
+	TemperatureDelta fromZero() const { return TemperatureDelta(value); }
+	// whole degrees, rounds to nearest
+	int16_t round() const { return Fixed::div(value, Fixed::One); }
+
+	Temperature clamp(Temperature lo, Temperature hi) const {
+		return value < lo.value ? lo : value > hi.value ? hi : *this;
+	}
+	// middle of a and b, rounds up, by halves so it can not overflow
+	static Temperature average(Temperature a, Temperature b) {
+		return Temperature((a.value >> 1) + (b.value >> 1) + ((a.value | b.value) & 1));
+	}
+	static Temperature max(Temperature a, Temperature b) { return a.value > b.value ? a : b; }
+	static Temperature min(Temperature a, Temperature b) { return a.value < b.value ? a : b; }
+
+	constexpr bool operator==(Temperature x) const { return value == x.value; }
+	constexpr bool operator!=(Temperature x) const { return value != x.value; }
+	constexpr bool operator<(Temperature x) const { return value < x.value; }
+	constexpr bool operator>(Temperature x) const { return value > x.value; }
+	constexpr bool operator<=(Temperature x) const { return value <= x.value; }
+	constexpr bool operator>=(Temperature x) const { return value >= x.value; }
 private:
 	int16_t value;
 };
 
+// 22.5_C is Temperature, 4_K is TemperatureDelta
+constexpr Temperature operator"" _C(long double v) { return Temperature::fromCelsius(v); }
+constexpr Temperature operator"" _C(unsigned long long v) { return Temperature::fromCelsius(v); }
+constexpr TemperatureDelta operator"" _K(long double v) { return TemperatureDelta::fromDegrees(v); }
+constexpr TemperatureDelta operator"" _K(unsigned long long v) { return TemperatureDelta::fromDegrees(v); }
+
+// one decimal, built as a whole, so width applies to all of it
 template <class S>
-S& operator<<(S& s, const Temperature& x)
+S& printFixed(S& s, int16_t v)
 {
 	static const char fracDigit[16] = {'0', '1', '1', '2', '3', '3', '4', '4',
 									   '5', '6', '6', '7', '8', '8', '9', '9' };
-	int16_t v = x.get();
-	if (v < 0) {
-		s << '-';
-		v = -v;
-	}
-	s << (v >> 4) << '.' << fracDigit[v & 15];
-	return s;
+	char buf[Format::MaxDigits];
+	char* p = buf + sizeof(buf);
+	uint16_t u = v < 0 ? -uint16_t(v) : v;
+	*--p = 0;
+	*--p = fracDigit[u & 15];
+	*--p = '.';
+	p = Format::toDecimal(uint16_t(u >> 4), p);
+	if (v < 0)
+		*--p = '-';
+	return s << (const char*)p;
+}
+
+template <class S>
+S& operator<<(S& s, const Temperature& x)
+{
+	return printFixed(s, x.get());
+}
+
+template <class S>
+S& operator<<(S& s, const TemperatureDelta& x)
+{
+	return printFixed(s, x.get());
 }
 
 
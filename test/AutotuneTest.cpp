@@ -0,0 +1,132 @@
+#include <math.h>
+
+#include "Test.h"
+#include "Autotune.h"
+#include "Regulator.h"
+
+/**
+ * Radiator feed mixed by a valve: position integrates valve run, feed
+ * follows the mix with first order Lag after dead time Delay.
+ * Positive run drives down, toward the cold return, like Regul output.
+ */
+class Plant {
+public:
+	static const uint16_t Step = 5000;      // ms, Regul::ReferencePeriod
+	static constexpr double Stroke = 120000; // ms of valve run
+	static constexpr double Hot = 70 * 16, Cold = 30 * 16;
+	static constexpr double Lag = 60;        // s
+	static const uint8_t Delay = 4;          // steps, 20 s
+
+	Plant(double position = 0.5) : position(position * Stroke), feed(mixed()) {
+		for (uint8_t i = 0; i < Delay; ++i)
+			line[i] = feed;
+	}
+	// 1/16 degree, after a step of Step with valve run
+	int16_t step(int16_t run) {
+		position -= run;
+		position = position < 0 ? 0 : position > Stroke ? Stroke : position;
+		for (uint8_t i = Delay - 1; i > 0; --i)
+			line[i] = line[i - 1];
+		line[0] = mixed();
+		feed += (line[Delay - 1] - feed) * (1 - exp(-Step / 1000.0 / Lag));
+		return int16_t(lround(feed));
+	}
+	// 1/16 degree per ms of run
+	static constexpr double gain() { return (Hot - Cold) / Stroke; }
+private:
+	double mixed() const { return Cold + (Hot - Cold) * position / Stroke; }
+
+	double position;
+	double feed;
+	double line[Delay];
+};
+
+// phase crossover of K e^-Ls / (s (1 + Ts)): atan(wT) + wL = pi/2
+static void ultimate(double& ku, double& pu) {
+	const double T = Plant::Lag, L = Plant::Delay * Plant::Step / 1000.0 + Plant::Step / 2000.0;
+	const double K = Plant::gain() * 1000 / Plant::Step; // per s of steps
+	double lo = 1e-5, hi = 1;
+	for (int k = 0; k < 100; ++k) {
+		double w = (lo + hi) / 2;
+		(atan(w * T) + w * L < M_PI / 2 ? lo : hi) = w;
+	}
+	ku = lo * sqrt(1 + lo * lo * T * T) / K;
+	pu = 2 * M_PI / lo * 1000;
+}
+
+static Autotune tuned(Plant& plant, int16_t target, Clock::clock_t& now) {
+	Autotune tuner;
+	tuner.start(now);
+	int16_t current = plant.step(0);
+	while (tuner.isRunning()) {
+		int16_t run = tuner.step(current - target, now);
+		current = plant.step(run);
+		now += Plant::Step;
+	}
+	return tuner;
+}
+
+// measured Ku and Pu are near the analytic ones; the describing function
+// of the relay is approximate, 20-40% on plants with lag and dead time
+static void relay() {
+	Plant plant;
+	Clock::clock_t now = 0;
+	Autotune tuner = tuned(plant, 50 * 16, now);
+	CHECK_EQUAL(tuner.status(), Autotune::Done);
+	double ku, pu;
+	ultimate(ku, pu);
+	double measuredKu = 4.0 * Autotune::DefaultAmplitude / (M_PI * tuner.amplitude());
+	printf("Autotune: Ku %.1f of %.1f, Pu %u of %.0f ms, %u min\n",
+			measuredKu, ku, unsigned(tuner.period()), pu, unsigned(now / 60000));
+	CHECK(fabs(measuredKu / ku - 1) < 0.4);
+	CHECK(fabs(tuner.period() / pu - 1) < 0.3);
+}
+
+// tuned Regul settles a target step without oscillation
+static int16_t closedLoop(Autotune::Rule rule) {
+	Plant plant;
+	Clock::clock_t now = 0;
+	Autotune tuner = tuned(plant, 50 * 16, now);
+	Autotune::Result g = tuner.result(rule);
+	printf("Autotune: rule %d p=%d i=%d d=%d\n", rule, g.p, g.i, g.d);
+	CHECK(g.p > 0);
+
+	// 5 degree step up, overshoot is above the target
+	const int16_t target = 55 * 16;
+	Regul<int16_t, 4000, -4000> regul(target, g.p, g.i, g.d);
+	int16_t current = plant.step(0), worst = 0, overshoot = 0;
+	for (uint16_t k = 0; k < 3600 / 5; ++k) {
+		current = plant.step(regul.step(current));
+		int16_t err = current - target;
+		if (err > overshoot)
+			overshoot = err;
+		if (k >= 2400 / 5 && abs(err) > worst)
+			worst = abs(err);
+	}
+	printf("Autotune: rule %d overshoot %d/16, last 20 min error %d/16\n", rule, overshoot, worst);
+	CHECK(worst <= 8);
+	return overshoot;
+}
+
+// a plant that does not move fails after MaxTime
+static void noResponse() {
+	Autotune tuner;
+	tuner.start(0);
+	Clock::clock_t now = 0;
+	while (tuner.isRunning() && now <= Autotune::MaxTime + Plant::Step) {
+		tuner.step(16, now);
+		now += Plant::Step;
+	}
+	CHECK_EQUAL(tuner.status(), Autotune::Failed);
+	CHECK_EQUAL(tuner.step(16, now), 0);
+}
+
+int main() {
+	relay();
+	int16_t zn = closedLoop(Autotune::ZieglerNichols);
+	int16_t tl = closedLoop(Autotune::TyreusLuyben);
+	CHECK(tl < zn);
+	CHECK(tl <= 5 * 16 / 4);
+	noResponse();
+	return Test::result("Autotune");
+}
@@ -0,0 +1,185 @@
+#include "Test.h"
+#include "Host.h"
+#include "Burner.h"
+
+/**
+ * Boiler under the relay: the flame lights while the relay is on and
+ * the burner ignites, the thermocouple heats by Rise with flame and
+ * cools by Fall to Ambient without. States entered are traced with
+ * their times, steps are one cycle apart.
+ */
+class Boiler {
+public:
+	static const uint16_t Cycle = 2500; // ms, cycle of defaults
+	static constexpr double Rise = 10 * 16, Fall = 3 * 16; // per minute
+	static constexpr double Ambient = 20 * 16;
+	static const uint8_t Size = 24;
+
+	Boiler() : tc(Ambient), ignites(true), flame(false), now(0), count(0) {}
+
+	// steps for seconds
+	void run(bool demand, uint32_t seconds) {
+		for (Clock::clock_t end = now + seconds * 1000; now < end; now += Cycle) {
+			flame = burner.isOn() && (flame || ignites);
+			tc += flame ? Rise * Cycle / 60000 : -Fall * Cycle / 60000;
+			tc = tc < Ambient ? Ambient : tc;
+			if (burner.step(demand, Temperature(int16_t(tc)), now) && count < Size) {
+				state[count] = burner.getState();
+				time[count++] = now;
+			}
+		}
+	}
+	// the flame goes out and does not light again
+	void blowOut() {
+		flame = false;
+		ignites = false;
+	}
+	// s from the traced entry i - 1 to i, of entry 0 from time 0
+	uint32_t after(uint8_t i) const {
+		return (time[i] - (i ? time[i - 1] : 0)) / 1000;
+	}
+	bool traced(const Burner::State* s, uint8_t n) const {
+		if (n != count)
+			return false;
+		for (uint8_t i = 0; i < n; ++i)
+			if (s[i] != state[i])
+				return false;
+		return true;
+	}
+	void clear() { count = 0; }
+
+	Burner burner;
+	double tc; // 1/16 degree
+	bool ignites;
+	bool flame;
+	Clock::clock_t now;
+	Burner::State state[Size];
+	Clock::clock_t time[Size];
+	uint8_t count;
+};
+
+static const uint16_t Delay = 600, DelayOff = 900, RetryDelay = 900; // s, defaults
+
+// starts after boilerDelay, burns once the trend rises
+static void ignition() {
+	Boiler b;
+	b.run(true, Delay + 120);
+	const Burner::State s[] = { Burner::Starting, Burner::Igniting, Burner::Burning };
+	CHECK(b.traced(s, 3));
+	CHECK_EQUAL(b.after(1), Delay);
+	CHECK(b.after(2) <= 40);
+	CHECK(b.burner.isOn());
+}
+
+// MaxAttempts quick restarts, then one each boilerRetryDelay
+static void failedIgnition() {
+	Boiler b;
+	b.ignites = false;
+	b.run(true, Delay + 3 * 90 + RetryDelay + 60);
+	const Burner::State s[] = { Burner::Starting, Burner::Igniting,
+		Burner::Restart, Burner::Igniting, Burner::Restart, Burner::Igniting,
+		Burner::Restart, Burner::Igniting, Burner::Restart, Burner::Igniting };
+	CHECK(b.traced(s, 10));
+	for (uint8_t i = 2; i < 8; i += 2) {
+		CHECK(b.after(i) >= Burner::IgnitionTime && b.after(i) <= Burner::IgnitionTime + 5);
+		CHECK_EQUAL(b.after(i + 1), Burner::RestartTime);
+	}
+	CHECK_EQUAL(b.after(8), RetryDelay);
+	// it lights at last
+	b.ignites = true;
+	b.clear();
+	b.run(true, 60);
+	CHECK(b.count == 1 && b.state[0] == Burner::Burning);
+}
+
+// lost flame is seen by the fall, long before the thermocouple is cold
+static void flameLoss() {
+	Boiler b;
+	b.run(true, Delay + 600);
+	CHECK_EQUAL(b.burner.getState(), Burner::Burning);
+	b.blowOut();
+	b.clear();
+	Clock::clock_t lost = b.now;
+	b.run(true, 60);
+	CHECK(b.count == 1 && b.state[0] == Burner::Cold);
+	CHECK((b.time[0] - lost) / 1000 <= 40);
+	CHECK(b.tc > Burner::TCHigh);
+	CHECK(b.burner.isOn());
+	// relay is cycled after boilerRetryDelay
+	b.run(true, RetryDelay);
+	CHECK(b.count == 2 && b.state[1] == Burner::Restart);
+}
+
+// a new demand gets the quick restarts again
+static void newDemand() {
+	Boiler b;
+	b.ignites = false;
+	b.run(true, Delay + 3 * 90 + 60);
+	CHECK_EQUAL(b.burner.getState(), Burner::Igniting);
+	b.run(false, DelayOff + 10);
+	CHECK_EQUAL(b.burner.getState(), Burner::Off);
+	b.clear();
+	b.run(true, Delay + 90);
+	const Burner::State s[] = { Burner::Starting, Burner::Igniting, Burner::Restart };
+	CHECK(b.traced(s, 3));
+	CHECK(b.after(2) <= Burner::IgnitionTime + 5);
+}
+
+// relay stays on for boilerDelayOff, demand in that time burns on
+static void stopping() {
+	Boiler b;
+	b.run(true, Delay + 120);
+	b.clear();
+	b.run(false, 100);
+	b.run(true, 10);
+	b.run(false, DelayOff + 10);
+	const Burner::State s[] = { Burner::Stopping, Burner::Burning, Burner::Stopping, Burner::Off };
+	CHECK(b.traced(s, 4));
+	CHECK_EQUAL(b.after(3), DelayOff);
+	CHECK(!b.burner.isOn());
+	// off at once while it waits for boilerDelay
+	b.clear();
+	b.run(true, 10);
+	b.run(false, 10);
+	const Burner::State t[] = { Burner::Starting, Burner::Off };
+	CHECK(b.traced(t, 2));
+}
+
+// state and time in it survive a reset, a bad state is Off
+static void restore() {
+	Boiler b;
+	b.run(true, Delay + 10);
+	CHECK_EQUAL(b.burner.getState(), Burner::Igniting);
+	Burner::Saved saved;
+	b.burner.save(saved, b.now);
+	CHECK_EQUAL(saved.elapsed, 10000);
+	Burner r;
+	r.restore(saved, 500000);
+	CHECK_EQUAL(r.getState(), Burner::Igniting);
+	CHECK(r.isOn() && r.isWanted());
+	// no restart before the trend is known again
+	CHECK(!r.step(true, Temperature(int16_t(Boiler::Ambient)), 500000));
+	saved.state = Burner::StateCount;
+	r.restore(saved, 500000);
+	CHECK_EQUAL(r.getState(), Burner::Off);
+	CHECK(!r.isOn());
+}
+
+static void names() {
+	char buf[10];
+	Burner::name(Burner::Stopping, buf);
+	CHECK(strcmp(buf, "stopping") == 0);
+}
+
+int main() {
+	Host::reset();
+	Params::init();
+	ignition();
+	failedIgnition();
+	flameLoss();
+	newDemand();
+	stopping();
+	restore();
+	names();
+	return Test::result("Burner");
+}
@@ -0,0 +1,138 @@
+#include <stdlib.h>
+
+#include "Test.h"
+#include "Filter.h"
+
+static const Filter::Config all = { Filter::PowerOn | Filter::Median | Filter::Rate | Filter::Ewma, 1, 16 };
+
+static bool put(Filter& f, int16_t x, Clock::clock_t now, const Filter::Config& c, int16_t& v) {
+	return f.put(x, now, c, v);
+}
+
+// 85 degree reset value is dropped unless it repeats or is expected
+static void powerOn() {
+	const Filter::Config c = { Filter::PowerOn, 0, 0 };
+	Filter f;
+	int16_t v = 0;
+	CHECK(put(f, (40_C).get(), 0, c, v));
+	CHECK(!put(f, Filter::PowerOnValue, 1000, c, v));
+	CHECK_EQUAL(v, (40_C).get());
+	CHECK(!put(f, Filter::PowerOnValue, 2000, c, v));
+	CHECK(put(f, Filter::PowerOnValue, 3000, c, v));
+	CHECK_EQUAL(v, Filter::PowerOnValue);
+
+	Filter hot;
+	CHECK(put(hot, (80_C).get(), 0, c, v));
+	CHECK(put(hot, Filter::PowerOnValue, 1000, c, v));
+
+	Filter first;
+	CHECK(!put(first, Filter::PowerOnValue, 0, c, v));
+}
+
+// a single spike does not pass, a step passes one sample later
+static void median() {
+	const Filter::Config c = { Filter::Median, 0, 0 };
+	Filter f;
+	int16_t v;
+	const int16_t in[] = { 320, 321, 1360, 322, 323, 500, 500, 500 };
+	const int16_t out[] = { 320, 321, 321, 322, 323, 323, 500, 500 };
+	for (uint8_t k = 0; k < sizeof(in) / sizeof(in[0]); ++k) {
+		CHECK(put(f, in[k], k * 1000, c, v));
+		CHECK_EQUAL(v, out[k]);
+	}
+}
+
+// change is limited to maxRate per started second
+static void rate() {
+	const Filter::Config c = { Filter::Rate, 0, (1_K).get() };
+	Filter f;
+	int16_t v;
+	put(f, (20_C).get(), 0, c, v);
+	put(f, (30_C).get(), 5000, c, v);
+	CHECK_EQUAL(v, (25_C).get());
+	put(f, (0_C).get(), 5500, c, v);
+	CHECK_EQUAL(v, (24_C).get());
+	// a day without samples, no overflow
+	put(f, Fixed::MinValue, 5500 + 86400000UL, c, v);
+	CHECK_EQUAL(v, Fixed::MinValue);
+	put(f, Fixed::MaxValue, 5500 + 2 * 86400000UL, c, v);
+	CHECK_EQUAL(v, Fixed::MaxValue);
+}
+
+// settles on a constant input exactly, from both sides
+static void ewma() {
+	const Filter::Config c = { Filter::Ewma, 2, 0 };
+	const int16_t targets[] = { -321, -1, 0, 1, 333, Fixed::MaxValue, Fixed::MinValue };
+	for (int16_t t : targets) {
+		Filter up, down;
+		int16_t a, b;
+		put(up, Fixed::MinValue, 0, c, a);
+		put(down, Fixed::MaxValue, 0, c, b);
+		for (uint8_t k = 1; k < 100; ++k) {
+			put(up, t, k * 1000, c, a);
+			put(down, t, k * 1000, c, b);
+		}
+		CHECK_EQUAL(a, t);
+		CHECK_EQUAL(b, t);
+	}
+	Filter f;
+	int16_t v;
+	put(f, 0, 0, c, v);
+	put(f, 160, 1000, c, v);
+	CHECK_EQUAL(v, 40);
+}
+
+static void reset() {
+	Filter f;
+	int16_t v;
+	put(f, (20_C).get(), 0, all, v);
+	f.reset();
+	CHECK(put(f, (60_C).get(), 1000, all, v));
+	CHECK_EQUAL(v, (60_C).get());
+}
+
+// noise of 1/16 and a spike every 20 samples: nothing of spikes passes,
+// the noise is smoothed
+static void noisy() {
+	Sensors::Filters filters;
+	srand(1);
+	int16_t v, worst = 0;
+	uint32_t moves = 0, previous = 0;
+	for (uint16_t k = 0; k < 2000; ++k) {
+		int16_t x = (45_C).get() + rand() % 3 - 1;
+		if (k % 20 == 10)
+			x = k % 40 == 10 ? Filter::PowerOnValue : (0_C).get();
+		if (!filters.put(Sensors::Radiator, x, k * 5000UL, v))
+			continue;
+		int16_t e = abs(v - (45_C).get());
+		if (k > 10 && e > worst)
+			worst = e;
+		if (v != int16_t(previous))
+			++moves;
+		previous = v;
+	}
+	printf("Filter: worst %d/16, output changed %u of 2000 samples\n", worst, unsigned(moves));
+	CHECK(worst <= 1);
+}
+
+static void benchmark() {
+	Sensors::Filters filters;
+	volatile int16_t sink;
+	double ns = Test::nsPerCall([&](uint32_t k) {
+		int16_t v;
+		filters.put(Sensors::BoilerOut, int16_t(800 + (k & 15)), k * 1000, v);
+		sink = v;
+	}, 10000000);
+	printf("Filter: full chain %.2f ns per sample\n", ns);
+}
+
+int main() {
+	powerOn();
+	median();
+	rate();
+	ewma();
+	reset();
+	noisy();
+	benchmark();
+	return Test::result("Filter");
+}
@@ -0,0 +1,122 @@
+#include <stdlib.h>
+
+#include "Test.h"
+#include "Format.h"
+#include "temperature.h"
+
+// every 16 bit value
+static void div10Short() {
+	int wrong = 0;
+	for (uint32_t n = 0; n <= 0xFFFF; ++n) {
+		uint8_t r;
+		uint16_t q = Format::div10(uint16_t(n), r);
+		wrong += q != n / 10 || r != n % 10;
+	}
+	CHECK_EQUAL(wrong, 0);
+}
+
+// low values, both ends of 32 bit and random ones between
+static void div10Long() {
+	int wrong = 0;
+	uint32_t x = 12345;
+	for (uint32_t i = 0; i < (1UL << 22); ++i) {
+		x = x * 1664525 + 1013904223;
+		const uint32_t n[] = { i, ~i, x };
+		for (uint8_t k = 0; k < 3; ++k) {
+			uint8_t r;
+			uint32_t q = Format::div10(n[k], r);
+			wrong += q != n[k] / 10 || r != n[k] % 10;
+		}
+	}
+	CHECK_EQUAL(wrong, 0);
+}
+
+static bool decimal(uint32_t n) {
+	char buf[Format::MaxDigits + 1];
+	char* end = buf + Format::MaxDigits;
+	*end = 0;
+	char expected[16];
+	snprintf(expected, sizeof(expected), "%lu", (unsigned long)n);
+	const char* p = n <= 0xFFFF ? Format::toDecimal(uint16_t(n), end) : Format::toDecimal(n, end);
+	return strcmp(p, expected) == 0;
+}
+
+static bool hex(uint32_t n) {
+	char buf[Format::MaxDigits + 1];
+	char* end = buf + Format::MaxDigits;
+	*end = 0;
+	char expected[16];
+	snprintf(expected, sizeof(expected), "%lX", (unsigned long)n);
+	return strcmp(Format::toHex(n, end), expected) == 0;
+}
+
+static void digits() {
+	const uint32_t n[] = { 0, 9, 10, 65535, 65536, 99999, 100000, 2147483648UL, 4294967295UL };
+	for (uint8_t i = 0; i < sizeof(n) / sizeof(n[0]); ++i) {
+		CHECK(decimal(n[i]));
+		CHECK(hex(n[i]));
+	}
+	int wrong = 0;
+	uint32_t x = 1;
+	for (uint32_t i = 0; i < 100000; ++i) {
+		x = x * 1664525 + 1013904223;
+		wrong += !decimal(x >> (i & 31)) + !hex(x);
+	}
+	CHECK_EQUAL(wrong, 0);
+}
+
+static const char* number(long n, uint8_t width, char fill, uint8_t base) {
+	static Test::Text t;
+	t.clear();
+	Format::number(t, n < 0 ? -(unsigned long)n : n, n < 0, width, fill, base);
+	return t.s;
+}
+
+// as the manipulators of SerialPort set them
+static void padding() {
+	CHECK(strcmp(number(0, 0, ' ', 10), "0") == 0);
+	CHECK(strcmp(number(-42, 0, ' ', 10), "-42") == 0);
+	CHECK(strcmp(number(-42, 5, ' ', 10), "  -42") == 0);
+	CHECK(strcmp(number(-42, 5, '0', 10), "-0042") == 0);
+	CHECK(strcmp(number(42, 5, '0', 10), "00042") == 0);
+	CHECK(strcmp(number(123456, 3, ' ', 10), "123456") == 0);
+	CHECK(strcmp(number(-2147483647L - 1, 0, ' ', 10), "-2147483648") == 0);
+	CHECK(strcmp(number(0xBEEF, 0, ' ', 16), "BEEF") == 0);
+	CHECK(strcmp(number(0xBEEF, 8, '0', 16), "0000BEEF") == 0);
+	Test::Text t;
+	Format::pad(t, "ab", 2, false, 4, '.');
+	CHECK(t == "..ab");
+}
+
+// fractions through the same digits
+static void temperatures() {
+	Test::Text t;
+	t << Temperature(int16_t(-8)) << ' ' << (22_C).fromZero() << ' ' << Temperature(int16_t(0x7FF8));
+	CHECK(t == "-0.5 22.0 2047.5");
+}
+
+// library division against shifts on the host; AVR cycles and flash size
+// against the old SerialPort padding need avr-gcc, avr-size and simavr
+static void benchmark() {
+	volatile uint32_t sink;
+	double library = Test::nsPerCall([&](uint32_t i) {
+		uint32_t n = i * 2654435761UL;
+		sink = n / 10 + n % 10;
+	}, 10000000);
+	double shifts = Test::nsPerCall([&](uint32_t i) {
+		uint8_t r;
+		uint32_t n = i * 2654435761UL;
+		sink = Format::div10(n, r) + r;
+	}, 10000000);
+	printf("Format: 32 bit /10 %.2f ns, div10 %.2f ns\n", library, shifts);
+}
+
+int main() {
+	div10Short();
+	div10Long();
+	digits();
+	padding();
+	temperatures();
+	benchmark();
+	return Test::result("Format");
+}
@@ -0,0 +1,62 @@
+#include <string.h>
+
+#include <avr/io.h>
+#include <util/delay.h>
+
+#include "Host.h"
+#include "Clock.h"
+
+#define HOST_REG(name) volatile uint8_t name;
+HOST_REG(UBRR0H) HOST_REG(UBRR0L) HOST_REG(UCSR0A) HOST_REG(UCSR0B) HOST_REG(UCSR0C) HOST_REG(UDR0)
+HOST_REG(TWSR) HOST_REG(TWBR) HOST_REG(TWCR) HOST_REG(TWDR)
+HOST_REG(TCNT0)
+HOST_REG(SREG) HOST_REG(SMCR)
+#undef HOST_REG
+
+namespace Host {
+
+uint8_t eeprom[E2END + 1];
+uint64_t micros;
+
+void advance(uint32_t us) {
+	micros += us;
+	TCNT0 = uint8_t(micros / Clock::TickMicros);
+}
+
+void reset() {
+	memset(eeprom, 0xFF, sizeof(eeprom));
+	micros = 0;
+	TCNT0 = 0;
+}
+
+} // namespace Host
+
+void eeprom_read_block(void* dst, const void* src, size_t n) {
+	memcpy(dst, Host::eeprom + reinterpret_cast<size_t>(src), n);
+}
+
+void eeprom_update_block(const void* src, void* dst, size_t n) {
+	memcpy(Host::eeprom + reinterpret_cast<size_t>(dst), src, n);
+}
+
+uint8_t eeprom_read_byte(const uint8_t* p) {
+	return Host::eeprom[reinterpret_cast<size_t>(p)];
+}
+
+void eeprom_update_byte(uint8_t* p, uint8_t value) {
+	Host::eeprom[reinterpret_cast<size_t>(p)] = value;
+}
+
+void _delay_us(double us) {
+	Host::advance(uint32_t(us));
+}
+
+void _delay_ms(double ms) {
+	Host::advance(uint32_t(ms * 1000));
+}
+
+void Clock::start() {}
+
+Clock::clock_t Clock::millis() {
+	return Clock::clock_t(Host::micros / 1000);
+}
@@ -0,0 +1,24 @@
+#ifndef HOST_H_
+#define HOST_H_
+
+#include <inttypes.h>
+
+#include <avr/eeprom.h>
+
+/**
+ * The controller on a PC. Time is simulated: it starts at 0 and moves
+ * only by delays of the sources and by advance() of a test, Timer0
+ * count follows it. EEPROM is an array cleared to 0xFF like a new chip.
+ */
+namespace Host {
+
+extern uint8_t eeprom[E2END + 1];
+extern uint64_t micros;
+
+void advance(uint32_t us);
+// erased EEPROM and time 0
+void reset();
+
+} // namespace Host
+
+#endif /* HOST_H_ */
@@ -0,0 +1,265 @@
+// Modbus slave against a master on a pseudo terminal. The master writes
+// RTU frames to the pty, the controller side takes them byte by byte
+// through USART_RX_vect of serial.cpp, at 9600 baud of simulated time,
+// and answers by poll() to the pty as it does to the USART.
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "Test.h"
+#include "Host.h"
+#include "Modbus.h"
+
+extern "C" void USART_RX_vect(void);
+
+static const uint32_t CharMicros = 1042; // 10 bits at 9600
+
+// the controller end of the pty, a Port of Modbus::poll()
+struct Line {
+	int fd;
+	uint64_t firstWrite; // us of the first reply byte, 0 if none
+
+	void write(char c) {
+		if (!firstWrite)
+			firstWrite = Host::micros;
+		CHECK_EQUAL(::write(fd, &c, 1), 1);
+	}
+};
+
+// bytes waiting on the line arrive one per character time, the main
+// loop polls after each of them unless busy, then every ms for ms;
+// returns us from the last byte to the reply, 0 if none
+static uint64_t run(Modbus& m, Line& line, uint16_t ms, bool busy = false) {
+	uint64_t last = Host::micros;
+	line.firstWrite = 0;
+	pollfd p = { line.fd, POLLIN, 0 };
+	uint8_t b;
+	while (poll(&p, 1, 50) == 1 && read(line.fd, &b, 1) == 1) {
+		Host::advance(CharMicros);
+		UDR0 = b;
+		USART_RX_vect();
+		last = Host::micros;
+		if (!busy)
+			m.poll(line, Clock::millis());
+	}
+	for (uint16_t i = 0; i < ms; ++i) {
+		Host::advance(1000);
+		m.poll(line, Clock::millis());
+	}
+	return line.firstWrite ? line.firstWrite - last : 0;
+}
+
+// the master end, frames with CRC
+struct Master {
+	int fd;
+
+	void send(const uint8_t* pdu, uint8_t n) {
+		uint8_t f[Modbus::Size];
+		memcpy(f, pdu, n);
+		uint16_t c = Modbus::crc(f, n);
+		f[n++] = c;
+		f[n++] = c >> 8;
+		CHECK_EQUAL(::write(fd, f, n), n);
+	}
+	// bytes of the reply, 0 if none within 100 ms of real time
+	uint8_t receive(uint8_t* buf) {
+		uint8_t n = 0;
+		pollfd p = { fd, POLLIN, 0 };
+		while (n < Modbus::Size && poll(&p, 1, 100) == 1) {
+			ssize_t r = read(fd, buf + n, Modbus::Size - n);
+			if (r <= 0)
+				break;
+			n += r;
+		}
+		return n;
+	}
+};
+
+static bool isFrame(const uint8_t* f, uint8_t n) {
+	return n >= 4 && Modbus::crc(f, n) == 0;
+}
+
+static int16_t word(const uint8_t* p) {
+	return int16_t(p[0] << 8 | p[1]);
+}
+
+int main() {
+	Host::reset();
+	Params::init();
+	Params::set(Params::find("mbAddr"), 7);
+	Params::apply();
+
+	int pty = posix_openpt(O_RDWR | O_NOCTTY);
+	CHECK(pty >= 0 && grantpt(pty) == 0 && unlockpt(pty) == 0);
+	int tty = open(ptsname(pty), O_RDWR | O_NOCTTY | O_NONBLOCK);
+	CHECK(tty >= 0);
+	termios raw;
+	tcgetattr(tty, &raw);
+	cfmakeraw(&raw);
+	tcsetattr(tty, TCSANOW, &raw);
+
+	Master master = { pty };
+	Line line = { tty, 0 };
+	Modbus m;
+	m.input[0] = 320;
+	m.input[1] = -5;
+	uint8_t r[Modbus::Size];
+	uint8_t n;
+
+	// 04 read input, reply within the frame gap of the last byte
+	{
+		const uint8_t q[] = { 7, 4, 0, 0, 0, 2 };
+		master.send(q, sizeof(q));
+		uint64_t us = run(m, line, 20);
+		CHECK(us > SerialRx::FrameGap * 1000UL && us <= (SerialRx::FrameGap + 2) * 1000UL);
+		n = master.receive(r);
+		CHECK_EQUAL(n, 9);
+		CHECK(isFrame(r, n));
+		CHECK_EQUAL(r[2], 4);
+		CHECK_EQUAL(word(r + 3), 320);
+		CHECK_EQUAL(word(r + 5), -5);
+	}
+	// 03 read holding, Params in table order
+	{
+		const uint8_t q[] = { 7, 3, 0, 0, 0, 3 };
+		master.send(q, sizeof(q));
+		run(m, line, 20);
+		n = master.receive(r);
+		CHECK_EQUAL(n, 11);
+		CHECK(isFrame(r, n));
+		for (uint8_t i = 0; i < 3; ++i)
+			CHECK_EQUAL(word(r + 3 + 2 * i), Params::get(i));
+	}
+	// 06 write single is echoed
+	uint8_t indoor = Params::find("indoor");
+	{
+		const uint8_t q[] = { 7, 6, 0, indoor, 0x01, 0x60 };
+		master.send(q, sizeof(q));
+		run(m, line, 20);
+		n = master.receive(r);
+		CHECK_EQUAL(n, 8);
+		CHECK(isFrame(r, n) && memcmp(r, q, sizeof(q)) == 0);
+		CHECK_EQUAL(Params::get(indoor), 0x160);
+	}
+	// out of range value
+	{
+		const uint8_t q[] = { 7, 6, 0, indoor, 0x7F, 0x00 };
+		master.send(q, sizeof(q));
+		run(m, line, 20);
+		n = master.receive(r);
+		CHECK_EQUAL(n, 5);
+		CHECK(isFrame(r, n));
+		CHECK_EQUAL(r[1], 0x86);
+		CHECK_EQUAL(r[2], Modbus::IllegalValue);
+		CHECK_EQUAL(Params::get(indoor), 0x160);
+	}
+	// 16 write multiple
+	uint8_t rP = Params::find("rP");
+	{
+		const uint8_t q[] = { 7, 16, 0, rP, 0, 2, 4, 0, 5, 0, 1 };
+		master.send(q, sizeof(q));
+		run(m, line, 20);
+		n = master.receive(r);
+		CHECK_EQUAL(n, 8);
+		CHECK(isFrame(r, n) && memcmp(r, q, 6) == 0);
+		CHECK_EQUAL(Params::get(rP), 5);
+		CHECK_EQUAL(Params::get(rP + 1), 1);
+	}
+	// 16 is all or nothing
+	{
+		const uint8_t q[] = { 7, 16, 0, rP, 0, 2, 4, 0, 9, 0x7F, 0 };
+		master.send(q, sizeof(q));
+		run(m, line, 20);
+		n = master.receive(r);
+		CHECK_EQUAL(n, 5);
+		CHECK_EQUAL(r[1], 0x90);
+		CHECK_EQUAL(r[2], Modbus::IllegalValue);
+		CHECK_EQUAL(Params::get(rP), 5);
+	}
+	// Command of 16 is checked with the other values
+	{
+		const uint8_t q[] = { 7, 16, Modbus::Command >> 8, 0, 0, 1, 2, 0, 3 };
+		master.send(q, sizeof(q));
+		run(m, line, 20);
+		n = master.receive(r);
+		CHECK_EQUAL(n, 5);
+		CHECK_EQUAL(r[1], 0x90);
+		CHECK_EQUAL(r[2], Modbus::IllegalValue);
+		const uint8_t save[] = { 7, 16, Modbus::Command >> 8, 0, 0, 1, 2, 0, 1 };
+		master.send(save, sizeof(save));
+		run(m, line, 20);
+		n = master.receive(r);
+		CHECK(n == 8 && isFrame(r, n) && memcmp(r, save, 6) == 0);
+	}
+	// unknown function and register
+	{
+		const uint8_t q[] = { 7, 5, 0, 0, 0, 1 };
+		master.send(q, sizeof(q));
+		run(m, line, 20);
+		n = master.receive(r);
+		CHECK(n == 5 && isFrame(r, n));
+		CHECK_EQUAL(r[1], 0x85);
+		CHECK_EQUAL(r[2], Modbus::IllegalFunction);
+	}
+	{
+		const uint8_t q[] = { 7, 4, 0, Modbus::InputCount, 0, 1 };
+		master.send(q, sizeof(q));
+		run(m, line, 20);
+		n = master.receive(r);
+		CHECK(n == 5 && isFrame(r, n));
+		CHECK_EQUAL(r[1], 0x84);
+		CHECK_EQUAL(r[2], Modbus::IllegalAddress);
+	}
+	// other slave, corrupt CRC: silence
+	{
+		const uint8_t q[] = { 8, 4, 0, 0, 0, 1 };
+		master.send(q, sizeof(q));
+		run(m, line, 20);
+		CHECK_EQUAL(master.receive(r), 0);
+		const uint8_t bad[] = { 7, 4, 0, 0, 0, 1, 0x12, 0x34 };
+		CHECK_EQUAL(write(pty, bad, sizeof(bad)), int(sizeof(bad)));
+		run(m, line, 20);
+		CHECK_EQUAL(master.receive(r), 0);
+	}
+	// broadcast is executed without reply
+	{
+		const uint8_t q[] = { 0, 6, 0, rP, 0, 3 };
+		master.send(q, sizeof(q));
+		run(m, line, 20);
+		CHECK_EQUAL(master.receive(r), 0);
+		CHECK_EQUAL(Params::get(rP), 3);
+	}
+	// two frames while the main loop is busy, told apart by the gap
+	{
+		const uint8_t a[] = { 7, 4, 0, 0, 0, 1 };
+		const uint8_t b[] = { 7, 4, 0, 1, 0, 1 };
+		master.send(a, sizeof(a));
+		run(m, line, 0, true);
+		Host::advance((SerialRx::FrameGap + 1) * 1000UL);
+		master.send(b, sizeof(b));
+		run(m, line, 20, true);
+		n = master.receive(r);
+		CHECK_EQUAL(n, 14);
+		CHECK(isFrame(r, 7) && isFrame(r + 7, 7));
+		CHECK_EQUAL(word(r + 3), 320);
+		CHECK_EQUAL(word(r + 10), -5);
+	}
+	// nothing unsolicited, and nothing at all once disabled
+	run(m, line, 2000);
+	CHECK_EQUAL(master.receive(r), 0);
+	Params::set(Params::find("mbAddr"), 0);
+	Params::apply();
+	{
+		const uint8_t q[] = { 7, 4, 0, 0, 0, 1 };
+		master.send(q, sizeof(q));
+		run(m, line, 20);
+		CHECK_EQUAL(master.receive(r), 0);
+	}
+
+	close(tty);
+	close(pty);
+	return Test::result("Modbus");
+}
@@ -0,0 +1,420 @@
+#include "Test.h"
+#include "Host.h"
+#include "OneWire.h"
+
+using namespace OneWire;
+
+/**
+ * DS18B20 on the simulated bus. A slot starts when the master pulls the
+ * line low, a sent 0 holds it low for 30 us from there; a written bit
+ * is 1 if the master releases within 15 us. Temperature is raw of the
+ * scratchpad, the configuration byte sets conversion time.
+ */
+class Device {
+public:
+	static const uint16_t SlotLow = 30;   // us of a sent 0
+	static const uint16_t Wait = 30;      // us from reset release to presence
+	static const uint16_t Presence = 120; // us
+
+	Device(uint8_t serial, int16_t raw, uint8_t bits = 12, bool parasite = false)
+		: mode(Idle), pos(0), in(0), phase(0), out(0), len(0), power(0), ready(0),
+		  lowFrom(0), lowUntil(0), parasite(parasite) {
+		const uint8_t r[7] = { 0x28, serial, uint8_t(serial * 7), 0x55, 0, 0, 0 };
+		uint8_t crc = 0;
+		for (uint8_t i = 0; i < 7; ++i)
+			crc = crc8(crc, rom[i] = r[i]);
+		rom[7] = crc;
+		pad[2] = 0x4B;
+		pad[3] = 0x46;
+		pad[4] = uint8_t((bits - 9) << 5 | 0x1F);
+		pad[5] = 0xFF;
+		pad[6] = 0x0C;
+		pad[7] = 0x10;
+		set(raw);
+	}
+	void set(int16_t raw) {
+		pad[0] = raw;
+		pad[1] = raw >> 8;
+		pad[8] = 0;
+		for (uint8_t i = 0; i < 8; ++i)
+			pad[8] = crc8(pad[8], pad[i]);
+	}
+	void reset(uint64_t now) {
+		mode = Command;
+		pos = in = 0;
+		lowFrom = now + Wait;
+		lowUntil = lowFrom + Presence;
+	}
+	// sent bit, flip inverts it
+	void slotStart(uint64_t now, bool flip) {
+		if (sent(now) == flip) {
+			lowFrom = now;
+			lowUntil = now + SlotLow;
+		}
+	}
+	void slotEnd(bool written, uint64_t now);
+	bool isLow(uint64_t now) const { return now >= lowFrom && now < lowUntil; }
+	bool isSending() const { return mode == Send || (mode == Search && phase < 2); }
+	uint16_t conversionTime() const { return 750 >> (3 - (pad[4] >> 5 & 3)); }
+
+	uint8_t rom[8];
+	uint8_t pad[9];
+private:
+	enum Mode { Idle, Command, Match, Search, Function, Send, Busy };
+
+	bool romBit() const { return rom[pos >> 3] >> (pos & 7) & 1; }
+	bool sent(uint64_t now) const {
+		switch (mode) {
+		case Send:   return pos >= len * 8 || (out[pos >> 3] >> (pos & 7) & 1);
+		case Search: return phase == 0 ? romBit() : phase == 1 ? !romBit() : true;
+		case Busy:   return now >= ready;
+		default:     return true;
+		}
+	}
+	void send(const uint8_t* p, uint8_t n) {
+		mode = Send;
+		out = p;
+		len = n;
+		pos = 0;
+	}
+	static uint8_t crc8(uint8_t crc, uint8_t data) {
+		for (uint8_t i = 8; i; --i) {
+			bool mix = (crc ^ data) & 1;
+			crc >>= 1;
+			if (mix)
+				crc ^= 0x8C;
+			data >>= 1;
+		}
+		return crc;
+	}
+
+	Mode mode;
+	uint8_t pos;   // bit of the byte, rom or data
+	uint8_t in;
+	uint8_t phase; // of a search bit: the bit, its complement, the choice
+	const uint8_t* out;
+	uint8_t len;
+	uint8_t power;
+	uint64_t ready; // us, end of conversion
+	uint64_t lowFrom, lowUntil;
+	bool parasite;
+};
+
+void Device::slotEnd(bool written, uint64_t now) {
+	switch (mode) {
+	case Command:
+	case Function:
+		in |= written << pos;
+		if (++pos < 8)
+			return;
+		pos = 0;
+		if (mode == Command) {
+			mode = in == 0x55 ? Match : in == 0xCC ? Function : in == 0xF0 ? Search : Idle;
+			if (in == 0x33)
+				send(rom, 8);
+		} else if (in == 0xBE) {
+			send(pad, 9);
+		} else if (in == 0xB4) {
+			power = parasite ? 0 : 0xFF;
+			send(&power, 1);
+		} else if (in == 0x44) {
+			mode = Busy;
+			ready = now + conversionTime() * 1000ULL;
+		} else {
+			mode = Idle;
+		}
+		in = 0;
+		break;
+	case Match:
+		if (written != romBit())
+			mode = Idle;
+		else if (++pos == 64)
+			mode = Function, pos = 0;
+		break;
+	case Search:
+		if (phase < 2) {
+			++phase;
+		} else {
+			phase = 0;
+			if (written != romBit())
+				mode = Idle;
+			else if (++pos == 64)
+				mode = Function, pos = 0;
+		}
+		break;
+	case Send:
+		++pos;
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * The line, low while the master drives it low, while a device pulls
+ * it, or for rise after a release. Sent bits of devices are flipped at
+ * random one in flipEvery, if set.
+ */
+struct Bus {
+	static const uint8_t MaxDevices = 4;
+	static const uint16_t ResetLow = 480; // us
+
+	Device* devices[MaxDevices];
+	uint8_t count;
+	bool output, port; // of the master pin
+	bool shorted;
+	uint16_t rise;     // us
+	uint32_t flipEvery;
+	uint32_t random;
+	uint64_t fall, release;
+
+	void clear() {
+		count = 0;
+		output = port = shorted = false;
+		rise = 0;
+		flipEvery = 0;
+		random = 1;
+		fall = release = 0;
+	}
+	void attach(Device& d) { devices[count++] = &d; }
+	bool masterLow() const { return output && !port; }
+	bool level() const {
+		uint64_t now = Host::micros;
+		if (masterLow() || shorted || now < release + rise)
+			return false;
+		for (uint8_t i = 0; i < count; ++i)
+			if (devices[i]->isLow(now))
+				return false;
+		return true;
+	}
+	// of the pin, before and after
+	void changed(bool wasLow) {
+		uint64_t now = Host::micros;
+		if (!wasLow && masterLow()) {
+			fall = now;
+			for (uint8_t i = 0; i < count; ++i)
+				devices[i]->slotStart(now, flip(devices[i]));
+		} else if (wasLow && !masterLow()) {
+			release = now;
+			for (uint8_t i = 0; i < count; ++i) {
+				if (now - fall >= ResetLow)
+					devices[i]->reset(now);
+				else
+					devices[i]->slotEnd(now - fall < 15, now);
+			}
+		}
+	}
+	bool flip(const Device* d) {
+		if (!flipEvery || !d->isSending())
+			return false;
+		random = random * 1664525 + 1013904223;
+		return (random >> 8) % flipEvery == 0;
+	}
+};
+
+static Bus bus;
+
+// data pin of the master
+struct Pin {
+	static void Set() { update(bus.output, true); }
+	static void Clear() { update(bus.output, false); }
+	static void SetDirWrite() { update(true, bus.port); }
+	static void SetDirRead() { update(false, bus.port); }
+	static bool IsSet() { return bus.level(); }
+private:
+	static void update(bool output, bool port) {
+		bool wasLow = bus.masterLow();
+		bus.output = output;
+		bus.port = port;
+		bus.changed(wasLow);
+	}
+};
+
+typedef Wire<Pin> W;
+typedef DS1820<W> DS;
+
+static void setUp() {
+	Host::reset();
+	bus.clear();
+	W::stats = BusStats();
+	DS::readStats = ReadStats();
+}
+
+static Addr addr(const Device& d) {
+	Addr a;
+	memcpy(a.bytes, d.rom, Addr::SIZE);
+	return a;
+}
+
+// presence is timed by Timer0 in TickMicros steps
+static void reset() {
+	setUp();
+	Device d(1, 0x150);
+	bus.attach(d);
+	CHECK(W::reset());
+	const uint16_t tick = Clock::TickMicros;
+	CHECK(W::stats.waitMin + tick >= Device::Wait && W::stats.waitMax <= Device::Wait + 2 * tick);
+	CHECK(W::stats.presenceMin + tick >= Device::Presence && W::stats.presenceMax <= Device::Presence + 2 * tick);
+	CHECK(W::stats.riseMax <= tick);
+	CHECK_EQUAL(W::stats.noPresence, 0);
+	bus.rise = 6;
+	CHECK(W::reset());
+	CHECK(W::stats.riseMax + tick >= 6 && W::stats.riseMax <= 6 + 2 * tick);
+	// a long cable is a short once it rises slower than RiseLimit
+	bus.rise = W::RiseLimit + 2 * tick;
+	CHECK(!W::reset());
+	CHECK_EQUAL(W::stats.shorts, 1);
+	bus.rise = 0;
+	bus.shorted = true;
+	CHECK(!W::reset());
+	CHECK_EQUAL(W::stats.shorts, 2);
+	bus.shorted = false;
+	bus.count = 0;
+	CHECK(!W::reset());
+	CHECK_EQUAL(W::stats.noPresence, 1);
+	CHECK_EQUAL(W::stats.resets, 5);
+}
+
+// every device once, addresses with their CRC
+static void search() {
+	setUp();
+	Device a(1, 0), b(2, 0), c(0x81, 0);
+	bus.attach(a);
+	bus.attach(b);
+	bus.attach(c);
+	Search<W> s;
+	uint8_t found = 0;
+	do {
+		Addr a = s();
+		for (uint8_t i = 0; i < bus.count; ++i)
+			found |= (a == addr(*bus.devices[i])) << i;
+	} while (!s.isDone());
+	CHECK(!s.isFail());
+	CHECK_EQUAL(found, 7);
+	CHECK_EQUAL(W::stats.searchFails, 0);
+	// a single device answers Read ROM
+	bus.count = 1;
+	CHECK(W::reset());
+	CHECK(W::readAddr() == addr(a));
+}
+
+// selected device of two, converted and waited for
+static void read() {
+	setUp();
+	Device a(1, 0x0191), b(2, -0x0050, 9); // 25.0625, -5
+	bus.attach(a);
+	bus.attach(b);
+	CHECK(DS::detectPower());
+	CHECK(!DS::isParasite());
+	CHECK(W::reset());
+	W::skip();
+	DS::convert();
+	uint64_t start = Host::micros;
+	DS::wait();
+	CHECK_EQUAL((Host::micros - start) / 1000, a.conversionTime());
+	DeviceStats sa = DeviceStats(), sb = DeviceStats();
+	CHECK_EQUAL(DS::read<2>(addr(a), sa).get(), 0x0191);
+	CHECK_EQUAL(DS::read<2>(addr(b), sb).get(), -0x0050);
+	CHECK(sa.isClean() && sb.isClean());
+	CHECK_EQUAL(DS::conversionTime(), 750);
+	// 9 bit devices only convert faster
+	CHECK(W::reset());
+	W::skip();
+	DS::convert();
+	CHECK(W::reset());
+	CHECK_EQUAL(DS::read<2>(addr(b), sb).get(), -0x0050);
+	CHECK(W::reset());
+	W::skip();
+	DS::convert();
+	CHECK_EQUAL(DS::conversionTime(), 94);
+	// a device stuck low is given up after MaxBusy
+	CHECK(W::reset());
+	W::skip();
+	DS::convert();
+	bus.shorted = true;
+	start = Host::micros;
+	CHECK(!DS::wait());
+	uint64_t busy = (Host::micros - start) / 1000; // of whole ms of Clock
+	CHECK(busy + 1 >= DS::MaxBusy && busy <= DS::MaxBusy);
+	CHECK_EQUAL(W::stats.timeouts, 1);
+	bus.shorted = false;
+}
+
+// us per read of a mode, bits flipped one in flipEvery
+static double readTime(ReadMode mode, uint32_t flipEvery, uint16_t n, uint16_t& wrong, uint16_t& fails) {
+	setUp();
+	Device d(1, 0x150);
+	bus.attach(d);
+	bus.flipEvery = flipEvery;
+	DeviceStats stats = DeviceStats();
+	wrong = fails = 0;
+	for (uint16_t i = 0; i < n; ++i) {
+		int16_t raw = 0x150 + (i / 50) % 8;
+		d.set(raw);
+		Temperature t = DS::read<3>(addr(d), stats, mode);
+		if (!t.isValid())
+			++fails;
+		else if (t.get() != raw)
+			++wrong;
+	}
+	return double(Host::micros) / n;
+}
+
+// short reads save slots, full ones catch flipped bits
+static void modes() {
+	uint16_t wrong, fails;
+	const uint16_t n = 2000;
+	double full = readTime(ReadFull, 0, n, wrong, fails);
+	CHECK(wrong == 0 && fails == 0);
+	CHECK_EQUAL(DS::readStats.full, n);
+	double brief = readTime(ReadShort, 0, n, wrong, fails);
+	CHECK(wrong == 0 && fails == 0);
+	CHECK_EQUAL(DS::readStats.shortReads, n);
+	double adaptive = readTime(ReadAdaptive, 0, n, wrong, fails);
+	CHECK(wrong == 0 && fails == 0);
+	CHECK_EQUAL(DS::readStats.full, (n + DS::FullEvery) / (DS::FullEvery + 1));
+	printf("OneWire: us per read full %.0f, short %.0f, adaptive %.0f\n", full, brief, adaptive);
+	CHECK(brief < full * 0.7);
+	CHECK(adaptive < full * 0.75);
+	// flipped bits: full reads never return a wrong value
+	readTime(ReadFull, 500, n, wrong, fails);
+	CHECK_EQUAL(wrong, 0);
+	CHECK(DS::readStats.crcErrors > 0);
+	readTime(ReadAdaptive, 500, n, wrong, fails);
+	printf("OneWire: adaptive with a flip in 500 bits, %u of %u wrong\n", wrong, n);
+	CHECK(DS::readStats.upgrades > 0);
+	CHECK(wrong <= n / 20);
+}
+
+// a real step is taken by a full read, 85 is not taken unread
+static void implausible() {
+	setUp();
+	Device d(1, 0x150);
+	bus.attach(d);
+	DeviceStats stats = DeviceStats();
+	CHECK_EQUAL(DS::read<2>(addr(d), stats, ReadAdaptive).get(), 0x150);
+	d.set(0x150 + 3 * DS::MaxStep);
+	CHECK_EQUAL(DS::read<2>(addr(d), stats, ReadAdaptive).get(), 0x150 + 3 * DS::MaxStep);
+	CHECK_EQUAL(DS::readStats.implausible, 1);
+	CHECK_EQUAL(DS::readStats.upgrades, 1);
+	CHECK(stats.isClean());
+	DeviceStats first = DeviceStats();
+	d.set((85_C).get());
+	CHECK(!DS::read<2>(addr(d), first, ReadShort).isValid());
+	CHECK_EQUAL(first.fails, 1);
+	// a parasite device is told by Read Power Supply
+	setUp();
+	Device p(2, 0x150, 12, true);
+	bus.attach(p);
+	CHECK(DS::detectPower());
+	CHECK(DS::isParasite());
+}
+
+int main() {
+	reset();
+	search();
+	read();
+	modes();
+	implausible();
+	return Test::result("OneWire");
+}
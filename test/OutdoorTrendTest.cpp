@@ -0,0 +1,132 @@
+#include <math.h>
+
+#include "Test.h"
+#include "Host.h"
+#include "OutdoorTrend.h"
+#include "HeatingCurve.h"
+#include "Cascade.h"
+
+static const uint16_t Sample = 20; // s between outdoor samples
+
+// degrees per hour from t0 for hours, samples from time 0
+static void ramp(OutdoorTrend& h, double t0, double perHour, double hours, Clock::clock_t& now) {
+	for (uint32_t s = 0; s < hours * 3600; s += Sample, now += Sample * 1000UL)
+		h.put(int16_t(lrint((t0 + perHour * s / 3600) * 16)), now);
+}
+
+static void slope() {
+	OutdoorTrend h;
+	Clock::clock_t now = 0;
+	ramp(h, 5, -1, 2.5 * OutdoorTrend::Interval / 3600.0, now);
+	CHECK(!h.isKnown());
+	CHECK_EQUAL(h.trend(), 0);
+	ramp(h, 4.375, -1, 3, now);
+	CHECK(h.isKnown());
+	CHECK(abs(h.trend() + 16) <= 1);
+	// flat weather after a full history
+	OutdoorTrend f;
+	now = 0;
+	ramp(f, -3, 0, 4, now);
+	CHECK_EQUAL(f.trend(), 0);
+	CHECK_EQUAL(f.last(0), -3 * 16);
+}
+
+// a stale sensor starts the history again
+static void gap() {
+	OutdoorTrend h;
+	Clock::clock_t now = 0;
+	ramp(h, 0, 2, 2, now);
+	CHECK(h.isKnown());
+	now += (OutdoorTrend::MaxGap + Sample) * 1000UL;
+	ramp(h, 4, 2, 0.5, now);
+	CHECK(!h.isKnown());
+	CHECK_EQUAL(h.trend(), 0);
+	// up to MaxGap is one history
+	OutdoorTrend k;
+	now = 0;
+	ramp(k, 0, 2, 2, now);
+	now += (OutdoorTrend::MaxGap - Sample) * 1000UL;
+	ramp(k, 4, 2, 0.5, now);
+	CHECK(k.isKnown());
+}
+
+static void predict() {
+	OutdoorTrend h;
+	Clock::clock_t now = 0;
+	CHECK(h.predict(5_C, 60) == 5_C);
+	ramp(h, 10, -4, 3, now);
+	CHECK(abs((h.predict(0_C, 60) - 0_C).get() + (4_K).get()) <= 1);
+	CHECK(h.predict(0_C, 240) == 0_C - 10_K);
+	CHECK(h.predict(0_C, 0) == 0_C);
+}
+
+// outdoor of the cold front and the thaw over a daily swing
+static double weather(double hour) {
+	double t = 3 * sin(hour / 24 * 2 * M_PI);
+	if (hour > 30)
+		t -= 12 * fmin(1, (hour - 30) / 6);
+	if (hour > 60)
+		t += 8 * fmin(1, (hour - 60) / 4);
+	return t;
+}
+
+// outdoor where the curve gives feed, the house holds 20 degree there
+static double outdoorOf(double feed) {
+	double lo = -40, hi = 30;
+	for (uint8_t i = 0; i < 40; ++i) {
+		double m = (lo + hi) / 2;
+		(HeatingCurve::feed(Temperature(int16_t(m * 16))).get() / 16.0 > feed ? lo : hi) = m;
+	}
+	return (lo + hi) / 2;
+}
+
+/**
+ * House fitting the heating curve: the feed covers the loss of
+ * 20 - outdoorOf(feed) degrees, radiators and floor pass it on with
+ * lag Emitter, the house follows it with lag House. Room correction as
+ * of RoomK of defaults. Returns rms of indoor error after the first
+ * half day, max error in worst.
+ */
+static double house(uint8_t lead, double& worst) {
+	const double Emitter = 2 * 3600, House = 30 * 3600; // s
+	OutdoorTrend h;
+	double indoor = 20, heat = 20 - weather(0);
+	double sum = 0;
+	uint32_t n = 0;
+	worst = 0;
+	for (uint32_t s = 0; s < 96 * 3600UL; s += Sample) {
+		double outdoor = weather(s / 3600.0);
+		int16_t o = int16_t(lrint(outdoor * 16));
+		h.put(o, s * 1000ULL);
+		double feed = HeatingCurve::feed(h.predict(Temperature(o), lead)).get() / 16.0
+				+ (20 - indoor) * RadiatorDefaults::RoomK;
+		heat += (20 - outdoorOf(feed) - heat) * Sample / Emitter;
+		indoor += (heat - (indoor - outdoor)) * Sample / House;
+		if (s > 12 * 3600UL) {
+			sum += (indoor - 20) * (indoor - 20);
+			++n;
+			worst = fmax(worst, fabs(indoor - 20));
+		}
+	}
+	return sqrt(sum / n);
+}
+
+static void lead() {
+	double worst, leadWorst;
+	double rms = house(0, worst);
+	double leadRms = house(RadiatorDefaults::Lead, leadWorst);
+	printf("OutdoorTrend: indoor error rms %.3f K, max %.3f K, with %d min lead %.3f K, %.3f K\n",
+			rms, worst, RadiatorDefaults::Lead, leadRms, leadWorst);
+	CHECK(leadRms < rms * 0.8);
+	CHECK(leadWorst < worst * 0.8);
+}
+
+int main() {
+	Host::reset();
+	HeatingCurve::init();
+	slope();
+	gap();
+	predict();
+	lead();
+	return Test::result("OutdoorTrend");
+}
@@ -0,0 +1,127 @@
+#include <stdlib.h>
+
+#include "Test.h"
+#include "Regulator.h"
+
+typedef Regul<int16_t, 4000, -4000> Radiator;
+typedef Regul<int16_t, 30000, -30000> Wide;
+typedef Pid::Core<20000, -20000> Core;
+
+// p only: output converges to p * err, halfway each step
+static void proportional() {
+	Radiator r(800, 4, 0, 0);
+	for (int k = 0; k < 20; ++k)
+		r.step(850);
+	CHECK_EQUAL(r.getOutput(), 200);
+	CHECK_EQUAL(r.getP(), 200);
+	CHECK_EQUAL(r.getI(), 0);
+}
+
+// beyond Large the output is at the limit and the state follows it
+static void large() {
+	Radiator r(800, 2, 10, 65);
+	CHECK_EQUAL(r.step(800 + 1001), 4000);
+	CHECK_EQUAL(r.getOutput(), 4000);
+	CHECK_EQUAL(r.step(800 - 1001), -4000);
+	CHECK_EQUAL(r.getOutput(), -4000);
+}
+
+// integral is limited to Max / 25 and not integrated while saturated,
+// so it unwinds in a few steps
+static void windup() {
+	Radiator r(800, 4, 200, 65);
+	for (int k = 0; k < 500; ++k) {
+		int16_t o = r.step(1700, 40000);
+		CHECK(o <= 4000 && o >= -4000);
+	}
+	CHECK_EQUAL(r.getOutput(), 900 * 4 + 4000 / 25);
+	CHECK_EQUAL(r.getI(), 4000 / 25);
+	Radiator s(800, 5, 200, 65);
+	for (int k = 0; k < 500; ++k)
+		s.step(1799, 40000);
+	CHECK_EQUAL(s.getOutput(), 4000);
+	CHECK_EQUAL(s.getI(), 0); // p alone saturates from the first step
+	int n = 0;
+	while (r.step(700) > 0 && n < 100)
+		++n;
+	CHECK(n < 10);
+}
+
+// a change of target does not kick the derivative
+static void derivativeOnMeasurement() {
+	Radiator r(800, 0, 0, 100);
+	for (int k = 0; k < 10; ++k)
+		r.step(800);
+	CHECK_EQUAL(r.getD(), 0);
+	r.setTarget(900);
+	r.step(800);
+	CHECK_EQUAL(r.getD(), 0);
+	r.step(810);
+	CHECK(r.getD() > 0);
+}
+
+// integral follows the sign of the error
+static void integral() {
+	Radiator up(0, 0, 16, 0), down(0, 0, 16, 0);
+	up.step(100);
+	down.step(-100);
+	CHECK_EQUAL(up.getI(), 100);
+	CHECK_EQUAL(down.getI(), -100);
+}
+
+// integral per step is proportional to dt
+static void period() {
+	Wide a(0, 0, 16, 0), b(0, 0, 16, 0);
+	a.step(1000, 2500);
+	b.step(1000, 5000);
+	CHECK_EQUAL(a.getI() * 2, b.getI());
+	Wide c(0, 0, 16, 0);
+	c.step(1000, 1);     // limited to ReferencePeriod / 8
+	CHECK_EQUAL(c.getI() * 4, a.getI());
+}
+
+// any input at any gain and dt stays in limits and does not overflow
+static void limits() {
+	const int16_t extremes[] = { -32768, -1001, -1000, -1, 0, 1, 1000, 1001, 32767 };
+	const uint8_t gains[] = { 0, 1, 128, 255 };
+	const uint16_t periods[] = { 1, 625, 5000, 40000, 65535 };
+	for (uint8_t p : gains) for (uint8_t i : gains) for (uint8_t d : gains) {
+		for (uint16_t dt : periods) {
+			Wide r(0, p, i, d);
+			for (int16_t x : extremes) {
+				for (int16_t y : extremes) {
+					r.step(x, dt);
+					int16_t o = r.step(y, dt);
+					CHECK(o >= -30000 && o <= 30000);
+				}
+			}
+		}
+	}
+	// the largest measurement change, d term must saturate with its sign
+	Core up, down;
+	up.step(0, -32768, 625, 5000, 0, 0, 255);
+	CHECK_EQUAL(up.step(0, 32767, 625, 5000, 0, 0, 255), 20000);
+	down.step(0, 32767, 625, 5000, 0, 0, 255);
+	CHECK_EQUAL(down.step(0, -32768, 625, 5000, 0, 0, 255), -20000);
+}
+
+static void benchmark() {
+	Wide r(800, 4, 20, 65);
+	volatile int16_t sink;
+	double ns = Test::nsPerCall([&](uint32_t k) {
+		sink = r.step(int16_t(760 + (k & 63)), 5000);
+	}, 10000000);
+	printf("Pid: step %.2f ns\n", ns);
+}
+
+int main() {
+	proportional();
+	large();
+	windup();
+	derivativeOnMeasurement();
+	integral();
+	period();
+	limits();
+	benchmark();
+	return Test::result("Pid");
+}
@@ -0,0 +1,101 @@
+#include "Test.h"
+#include "temperature.h"
+
+static_assert((22.5_C).get() == 360, "decimal literal");
+static_assert((-5_C).get() == -80, "negative literal");
+static_assert((0.5_K).get() == 8, "delta literal");
+static_assert((0.03_C).get() == 0, "rounds down below half");
+static_assert((0.04_C).get() == 1, "rounds up from half");
+static_assert((-0.04_C).get() == -1, "rounds away from zero");
+static_assert((3000_C).get() == Fixed::MaxValue, "literal saturates");
+static_assert(Temperature::toInt(200) == 200 * 16, "whole degrees over 127");
+
+static void arithmetic() {
+	const Temperature top(Fixed::MaxValue - 16), bottom(Fixed::MinValue + 16);
+	CHECK_EQUAL((top + 2_K).get(), Fixed::MaxValue);
+	CHECK_EQUAL((bottom - 2_K).get(), Fixed::MinValue);
+	CHECK_EQUAL((bottom + -2_K).get(), Fixed::MinValue);
+	CHECK_EQUAL((top - bottom).get(), Fixed::MaxValue);
+	CHECK_EQUAL((bottom - top).get(), Fixed::MinValue);
+	CHECK_EQUAL((-Temperature(Fixed::MinValue)).get(), Fixed::MaxValue);
+	CHECK_EQUAL((TemperatureDelta(10000) * 4).get(), Fixed::MaxValue);
+	CHECK_EQUAL((TemperatureDelta(-10000) * 4).get(), Fixed::MinValue);
+	CHECK_EQUAL((TemperatureDelta(-100) * int8_t(-128)).get(), 12800);
+	CHECK((20_C + 2.5_K) == 22.5_C);
+	CHECK(22_C - 20_C == 2_K);
+}
+
+static void rounding() {
+	CHECK_EQUAL((TemperatureDelta(3) / 2).get(), 2);
+	CHECK_EQUAL((TemperatureDelta(-3) / 2).get(), -2);
+	CHECK_EQUAL((TemperatureDelta(5) / 4).get(), 1);
+	CHECK_EQUAL((TemperatureDelta(Fixed::MaxValue) / 2).get(), 0x4000);
+	CHECK_EQUAL((TemperatureDelta(Fixed::MinValue) / 2).get(), -0x4000);
+	CHECK_EQUAL(((-5_C).fromZero() / 2).get(), -40);
+	CHECK_EQUAL((22.5_C).round(), 23);
+	CHECK_EQUAL((-22.5_C).round(), -23);
+	CHECK_EQUAL((22.4_C).round(), 22);
+	CHECK_EQUAL(Temperature::average(Temperature(10), Temperature(13)).get(), 12);
+	CHECK_EQUAL(Temperature::average(Temperature(Fixed::MinValue), Temperature(Fixed::MaxValue)).get(), 0);
+	CHECK((90_C).clamp(22_C, 70_C) == 70_C);
+	CHECK((10_C).clamp(22_C, 70_C) == 22_C);
+}
+
+// all sums and differences against 32 bit math
+static void exhaustive() {
+	const int16_t values[] = { Fixed::MinValue, -20000, -16384, -1, 0, 1, 7, 16384, 20000, Fixed::MaxValue };
+	for (int16_t a : values) {
+		for (int16_t b : values) {
+			CHECK_EQUAL(Fixed::add(a, b), Fixed::saturate(int32_t(a) + b));
+			CHECK_EQUAL(Fixed::sub(a, b), Fixed::saturate(int32_t(a) - b));
+		}
+	}
+	const int16_t divisors[] = { 1, 2, 3, 16, 100, Fixed::MaxValue };
+	for (int32_t a = Fixed::MinValue; a <= Fixed::MaxValue; a += 3) {
+		for (int16_t d : divisors) {
+			int32_t nearest = a >= 0 ? (2 * a + d) / (2 * d) : -((-2 * a + d) / (2 * d));
+			CHECK_EQUAL(Fixed::div(a, d), nearest);
+		}
+		for (int16_t b : values)
+			CHECK_EQUAL(Temperature::average(Temperature(a), Temperature(b)).get(), (a + b + 1) >> 1);
+	}
+	const int8_t factors[] = { -128, -3, -1, 0, 1, 4, 5, 127 };
+	for (int32_t a = Fixed::MinValue; a <= Fixed::MaxValue; ++a)
+		for (int8_t k : factors)
+			CHECK_EQUAL(Fixed::mul(a, k), Fixed::saturate(a * k));
+}
+
+static void text() {
+	Test::Text s;
+	s << 22.5_C;
+	CHECK(s == "22.5");
+	s.clear();
+	s << -0.5_K;
+	CHECK(s == "-0.5");
+	s.clear();
+	s << Temperature(Fixed::MinValue);
+	CHECK(s == "-2048.0");
+}
+
+// the same cascade expression on raw integers and on the types
+static void benchmark() {
+	volatile int16_t sink;
+	double raw = Test::nsPerCall([&](uint32_t i) {
+		int16_t outdoor = int16_t(i & 0x3FF) - 512, indoor = int16_t(i & 0xFF) + 300;
+		sink = 800 - outdoor / 2 + (352 - indoor) * 4;
+	}, 10000000);
+	double typed = Test::nsPerCall([&](uint32_t i) {
+		Temperature outdoor(int16_t(i & 0x3FF) - 512), indoor(int16_t(i & 0xFF) + 300);
+		sink = (50_C - outdoor.fromZero() / 2 + (22_C - indoor) * 4).get();
+	}, 10000000);
+	printf("Temperature: raw %.2f ns, saturating %.2f ns\n", raw, typed);
+}
+
+int main() {
+	arithmetic();
+	rounding();
+	exhaustive();
+	text();
+	benchmark();
+	return Test::result("Temperature");
+}
@@ -0,0 +1,87 @@
+#ifndef TEST_H_
+#define TEST_H_
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Checks of host tests. A failed check prints itself and the test goes
+ * on, main() returns result() so make stops at a failed test.
+ * Benchmarks compare variants on the same host, their times are only
+ * printed: host timings say nothing of AVR cycles.
+ *
+ * Example
+ *
+ * 		CHECK(t.isValid());
+ * 		CHECK_EQUAL(t.get(), 360);
+ * 		return Test::result("Temperature");
+ */
+namespace Test {
+
+inline int& failures() {
+	static int n = 0;
+	return n;
+}
+
+inline void check(bool ok, const char* expr, const char* file, int line) {
+	if (!ok) {
+		++failures();
+		printf("%s:%d: failed %s\n", file, line, expr);
+	}
+}
+
+inline void checkEqual(long a, long b, const char* ea, const char* eb, const char* file, int line) {
+	if (a != b) {
+		++failures();
+		printf("%s:%d: failed %s == %s, %ld != %ld\n", file, line, ea, eb, a, b);
+	}
+}
+
+inline int result(const char* name) {
+	printf("%s: %s\n", name, failures() ? "FAILED" : "ok");
+	return failures() != 0;
+}
+
+// stream of the sources into a string
+struct Text {
+	char s[256];
+	size_t n;
+
+	Text() { clear(); }
+	void clear() { n = 0; s[0] = 0; }
+	Text& operator<<(char c) {
+		if (n + 1 < sizeof(s)) {
+			s[n++] = c;
+			s[n] = 0;
+		}
+		return *this;
+	}
+	// output of Format::pad()
+	void put(char c) { *this << c; }
+	Text& operator<<(const char* x) {
+		while (*x)
+			*this << *x++;
+		return *this;
+	}
+	bool operator==(const char* x) const { return strcmp(s, x) == 0; }
+};
+
+// ns per call of f(i) for i = 0..n-1
+template <class F>
+double nsPerCall(F f, uint32_t n) {
+	timespec a, b;
+	clock_gettime(CLOCK_MONOTONIC, &a);
+	for (uint32_t i = 0; i < n; ++i)
+		f(i);
+	clock_gettime(CLOCK_MONOTONIC, &b);
+	return ((b.tv_sec - a.tv_sec) * 1e9 + (b.tv_nsec - a.tv_nsec)) / n;
+}
+
+} // namespace Test
+
+#define CHECK(expr) Test::check((expr), #expr, __FILE__, __LINE__)
+#define CHECK_EQUAL(a, b) Test::checkEqual((a), (b), #a, #b, __FILE__, __LINE__)
+
+#endif /* TEST_H_ */
@@ -0,0 +1,15 @@
+// EEPROM is Host::eeprom, see Host.h
+#ifndef HOST_AVR_EEPROM_H_
+#define HOST_AVR_EEPROM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define E2END 0x3FF
+
+void eeprom_read_block(void* dst, const void* src, size_t n);
+void eeprom_update_block(const void* src, void* dst, size_t n);
+uint8_t eeprom_read_byte(const uint8_t* p);
+void eeprom_update_byte(uint8_t* p, uint8_t value);
+
+#endif /* HOST_AVR_EEPROM_H_ */
@@ -0,0 +1,11 @@
+// tests call vectors directly
+#ifndef HOST_AVR_INTERRUPT_H_
+#define HOST_AVR_INTERRUPT_H_
+
+#define ISR(vector) extern "C" void vector(void)
+#define EMPTY_INTERRUPT(vector) extern "C" void vector(void) {}
+
+inline void sei() {}
+inline void cli() {}
+
+#endif /* HOST_AVR_INTERRUPT_H_ */
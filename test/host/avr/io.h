@@ -0,0 +1,27 @@
+// registers of atmega328p used by the sources, plain memory on host
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#define _BV(b) (1 << (b))
+
+#define HOST_REG(name) extern volatile uint8_t name;
+HOST_REG(UBRR0H) HOST_REG(UBRR0L) HOST_REG(UCSR0A) HOST_REG(UCSR0B) HOST_REG(UCSR0C) HOST_REG(UDR0)
+HOST_REG(TWSR) HOST_REG(TWBR) HOST_REG(TWCR) HOST_REG(TWDR)
+HOST_REG(TCNT0)
+HOST_REG(SREG) HOST_REG(SMCR)
+#undef HOST_REG
+
+enum {
+	RXEN0 = 4, TXEN0 = 3, RXCIE0 = 7, UDRIE0 = 5, TXCIE0 = 6, UCSZ00 = 1, UCSZ01 = 2,
+	RXC0 = 7, TXC0 = 6, UDRE0 = 5, FE0 = 4, DOR0 = 3, UPE0 = 2, U2X0 = 1,
+	TWINT = 7, TWEA = 6, TWSTA = 5, TWSTO = 4, TWEN = 2, TWIE = 0
+};
+
+#endif /* HOST_AVR_IO_H_ */
@@ -0,0 +1,18 @@
+// flash is plain memory on host
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define PGM_P const char*
+
+inline uint8_t pgm_read_byte(const void* p) { return *static_cast<const uint8_t*>(p); }
+inline uint16_t pgm_read_word(const void* p) { return *static_cast<const uint16_t*>(p); }
+inline uint32_t pgm_read_dword(const void* p) { return *static_cast<const uint32_t*>(p); }
+inline void* memcpy_P(void* d, const void* s, size_t n) { return memcpy(d, s, n); }
+inline int strcmp_P(const char* a, const char* b) { return strcmp(a, b); }
+
+#endif /* HOST_AVR_PGMSPACE_H_ */
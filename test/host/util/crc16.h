@@ -0,0 +1,21 @@
+// the same polynomials as avr-libc
+#ifndef HOST_UTIL_CRC16_H_
+#define HOST_UTIL_CRC16_H_
+
+#include <stdint.h>
+
+inline uint16_t _crc16_update(uint16_t crc, uint8_t a) {
+	crc ^= a;
+	for (uint8_t i = 0; i < 8; ++i)
+		crc = crc & 1 ? (crc >> 1) ^ 0xA001 : crc >> 1;
+	return crc;
+}
+
+inline uint8_t _crc_ibutton_update(uint8_t crc, uint8_t data) {
+	crc ^= data;
+	for (uint8_t i = 0; i < 8; ++i)
+		crc = crc & 1 ? (crc >> 1) ^ 0x8C : crc >> 1;
+	return crc;
+}
+
+#endif /* HOST_UTIL_CRC16_H_ */
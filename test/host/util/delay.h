@@ -0,0 +1,8 @@
+// delays advance the host time, see Host.h
+#ifndef HOST_UTIL_DELAY_H_
+#define HOST_UTIL_DELAY_H_
+
+void _delay_us(double us);
+void _delay_ms(double ms);
+
+#endif /* HOST_UTIL_DELAY_H_ */